@@ -0,0 +1,136 @@
+// Times loading a generated workspace of many projects (10k by default): from its XML, as after
+// the XML changed, and from the snapshot cbuild keeps next to it. The XML is also parsed alone, both
+// copied (the baseline) and in place.
+//
+// Usage: workspace_load [projects] [runs]
+#define main cbuild_main
+#include "cbuild.cpp"
+#undef main
+
+#include <chrono>
+
+namespace
+{
+
+    // Each project: two configurations, a few shared and a few of its own defines and include
+    // dirs, one source dir and three references to projects before it
+    bool WriteWorkspace(const std::string& Filepath, uint32_t Projects) noexcept
+    {
+        FILE* pFile = fopen(Filepath.c_str(), "w");
+        if (!pFile)
+        {
+            return false;
+        }
+
+        uint64_t kRandom = 1;
+        const auto Next = [&kRandom](uint32_t Bound) -> uint32_t
+        {
+            kRandom = kRandom * 6364136223846793005ull + 1442695040888963407ull;
+            return Bound ? (uint32_t)((kRandom >> 33) % Bound) : 0u;
+        };
+
+        fprintf(pFile, "<?xml version=\"1.0\"?>\n<!-- generated -->\n<Workspace Name=\"Big\">\n");
+        fprintf(pFile, "  <OutputDir>bin</OutputDir>\n  <IntermediateDir>bin-int</IntermediateDir>\n");
+        for (uint32_t kIndex = 0; kIndex < Projects; kIndex++)
+        {
+            fprintf(pFile, "  <Project Name=\"P%u\" Kind=\"StaticLibrary\" Language=\"C++\" CppVersion=\"20\" Compiler=\"g++\">\n", kIndex);
+            for (const char* lpConfig : { "Debug", "Release" })
+            {
+                fprintf(pFile, "    <Configuration Name=\"%s\"><Flags><Item>O2</Item><Item>g</Item><Item>Wall</Item></Flags>"
+                    "<Defines><Item>%s</Item><Item>NAME_P%u</Item></Defines></Configuration>\n", lpConfig, lpConfig, kIndex);
+            }
+            fprintf(pFile, "    <GlobalDefines><Item>COMMON=1</Item><Item>USE_FOO</Item><Item>&quot;X&quot;</Item></GlobalDefines>\n");
+            fprintf(pFile, "    <IncludeDirs><Item>include/common0</Item><Item>include/common1</Item><Item>include/common2</Item>"
+                "<Item>include/common3</Item><Item>src/P%u/include</Item></IncludeDirs>\n", kIndex);
+            fprintf(pFile, "    <SourceDirs><Item>src/P%u</Item></SourceDirs>\n", kIndex);
+            fprintf(pFile, "    <References><Item>P%u</Item><Item>P%u</Item><Item>P%u</Item></References>\n",
+                Next(kIndex), Next(kIndex), Next(kIndex));
+            fprintf(pFile, "  </Project>\n");
+        }
+        fprintf(pFile, "</Workspace>\n");
+
+        return fclose(pFile) == 0;
+    }
+
+    // Best and median of `Runs` runs of `Fn`, in milliseconds
+    template<typename F>
+    void Measure(const char* lpName, uint32_t Runs, F&& Fn) noexcept
+    {
+        Cbuild::List<double> times = {};
+        for (uint32_t kRun = 0; kRun < Runs; kRun++)
+        {
+            const auto tStart = std::chrono::steady_clock::now();
+            Fn();
+            times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count());
+        }
+        std::sort(times.begin(), times.end());
+        printf("%-10s best %7.1f ms   median %7.1f ms\n", lpName, times.front(), times[times.size() / 2ull]);
+    }
+
+}
+
+int main(int iArgc, char* ppArgv[])
+{
+    namespace stdfs = std::filesystem;
+
+    const uint32_t kProjects = iArgc > 1 ? (uint32_t)std::strtoul(ppArgv[1], nullptr, 10) : 10000u;
+    const uint32_t kRuns = iArgc > 2 ? std::max(1u, (uint32_t)std::strtoul(ppArgv[2], nullptr, 10)) : 15u;
+
+    std::error_code ec = {};
+    const stdfs::path dir = stdfs::temp_directory_path(ec) / std::format("cbuild_bench_{}", (uint64_t)getpid());
+    stdfs::create_directories(dir, ec);
+    const std::string xml = (dir / "big.xml").string();
+    const std::string snapshot = xml + ".cbuild_cache";
+    if (!WriteWorkspace(xml, kProjects))
+    {
+        printf("[ERROR]: Failed to write `%s`\n", xml.c_str());
+        return 1;
+    }
+    printf("%u projects, %ju bytes of XML, %u runs\n", kProjects, (uintmax_t)stdfs::file_size(xml, ec), kRuns);
+
+    // The baseline: pugixml's own load, which copies the file into a buffer of its own and keeps every node
+    Measure("copy", kRuns, [&]()
+    {
+        pugi::xml_document doc = {};
+        doc.load_file(xml.c_str(), pugi::parse_full);
+    });
+    // The same document, parsed in place from the mapped XML with only the nodes cbuild reads
+    Measure("inplace", kRuns, [&]()
+    {
+        pugi::xml_document doc = {};
+        Cbuild::Platform::MappedFile file = {};
+        file.Open(xml.c_str(), true);
+        doc.load_buffer_inplace(file.GetData(), file.GetSize(), Cbuild::XmlReadHelper::ParseOptions, pugi::encoding_utf8);
+    });
+
+    size_t kLoaded = 0;
+    // Parse and model only
+    Measure("parse", kRuns, [&]()
+    {
+        Cbuild::Workspace wks = {};
+        Cbuild::Platform::MappedFile file = {};
+        file.Open(xml.c_str(), true);
+        Cbuild::XmlReadHelper::LoadWorkspace(&wks, xml.c_str(), file.GetData(), file.GetSize());
+        kLoaded = wks.Projects.size();
+    });
+    // What `cbuild` does after the XML changed: parse, then write the snapshot
+    Measure("xml", kRuns, [&]()
+    {
+        stdfs::remove(snapshot, ec);
+        Cbuild::Workspace wks = {};
+        wks.Load(xml.c_str());
+    });
+    Measure("snapshot", kRuns, [&]()
+    {
+        Cbuild::Workspace wks = {};
+        wks.Load(xml.c_str());
+    });
+
+    stdfs::remove_all(dir, ec);
+    if (kLoaded != kProjects)
+    {
+        printf("[ERROR]: Loaded %zu of %u projects\n", kLoaded, kProjects);
+        return 1;
+    }
+    return 0;
+}
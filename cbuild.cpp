@@ -4,11 +4,45 @@
 #include <stdio.h>
 
 #include <type_traits>
+#include <algorithm>
 #include <memory>
+#include <unordered_set>
 #include <filesystem>
 #include <format>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <deque>
+#include <chrono>
+#include <span>
+#include <array>
+#include <charconv>
 
+#if defined(CBUILD_WIN32)
 #include <Windows.h>
+#elif defined(CBUILD_LINUX)
+#include <spawn.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+extern char** environ;
+#endif // CBUILD_WIN32
 
 #include <pugixml/pugixml.hpp>
 
@@ -33,11 +67,11 @@ static void __CbuildAssert(bool bCondition, const char* lpFile, const char* lpFu
 
         static char s_Message[1024] = {};
         memset(s_Message, 0, sizeof(s_Message));
-        _snprintf_s(s_Message, sizeof(s_Message), "[%s(%d), in %s]: %s\n", lpFile, iLine, lpFunction, lpFormat);
+        snprintf(s_Message, sizeof(s_Message), "[%s(%d), in %s]: %s\n", lpFile, iLine, lpFunction, lpFormat);
         
         va_list vArgs;
         va_start(vArgs, lpFormat);
-        vprintf_s(s_Message, vArgs);
+        vprintf(s_Message, vArgs);
         va_end(vArgs);
 
         std::terminate();
@@ -56,12 +90,23 @@ namespace Cbuild::Argv
     {
         const char* WksXmlFilepath = nullptr; // required
         const char* BuildConfiguration = nullptr; // required
+        ExecutionOptions Execution = {};
+        List<const char*> Targets = {}; // `--target` projects or files (to only build what they need), all projects if none
+        const char* CompileFile = nullptr; // `--compile-file <source>` compiles just that (`--syntax-only`: only parses it)
+        bool SyntaxOnly = false;
+        bool Check = false; // `--check` parses the sources that changed instead of building
+        const char* Query = nullptr; // `query <name> args...` answers a question instead of building (only "rdeps" for now)
+        List<const char*> QueryArgs = {};
 
         inline BuildOptions(int iArgc, char* ppArgv[])
         {
             static const char* const s_Usages[] =
             {
                 "cbuild <file.xml> [option [--] args...]...",
+                "cbuild <file.xml> --config <name> [--target <project|file>]... [-j <jobs>] [-k <failures>] [--mem-budget <MiB>] [--max-load <load>] [--max-pressure <pct>] [--batch <compiles>] [--bypass-driver] [-v|--verbose]   (-k: stops after that many failed jobs, 1 by default; 0 keeps going)",
+                "cbuild <file.xml> --config <name> --check [--target <project|file>]... [-j <jobs>] [-k <failures>]   (parses the sources that changed, builds nothing)",
+                "cbuild <file.xml> --config <name> --compile-file <source> [--syntax-only]   (one source, as the build would compile it)",
+                "cbuild <file.xml> --config <name> query rdeps <file>...   (the objects and outputs that a change to the files affects)",
             };
 
             static const auto ShowHelpMessage = [](const char* lpErrorMessage = nullptr, ...) -> void
@@ -107,6 +152,69 @@ namespace Cbuild::Argv
                 {
                     BuildConfiguration = ppArgv[kOffset + kIndex++];
                 }
+                else if ((arg == "-t" || arg == "--target") && (kArgc - kIndex) >= 1ul)
+                {
+                    Targets.push_back(ppArgv[kOffset + kIndex++]);
+                }
+                else if (arg == "--compile-file" && (kArgc - kIndex) >= 1ul)
+                {
+                    CompileFile = ppArgv[kOffset + kIndex++];
+                }
+                else if (arg == "--syntax-only")
+                {
+                    SyntaxOnly = true;
+                }
+                else if (arg == "--check")
+                {
+                    Check = true;
+                }
+                else if ((arg == "-j" || arg == "--jobs") && (kArgc - kIndex) >= 1ul)
+                {
+                    Execution.Jobs = (uint32_t)std::strtoul(ppArgv[kOffset + kIndex++], nullptr, 10);
+                }
+                else if (arg == "--mem-budget" && (kArgc - kIndex) >= 1ul)
+                {
+                    Execution.MemoryBudgetKb = std::strtoull(ppArgv[kOffset + kIndex++], nullptr, 10) * 1024ull;
+                }
+                else if ((arg == "-k" || arg == "--keep-going") && (kArgc - kIndex) >= 1ul)
+                {
+                    Execution.MaxFailures = (uint32_t)std::strtoul(ppArgv[kOffset + kIndex++], nullptr, 10);
+                }
+                else if (arg == "--batch" && (kArgc - kIndex) >= 1ul)
+                {
+                    Execution.MaxBatch = (uint32_t)std::strtoul(ppArgv[kOffset + kIndex++], nullptr, 10);
+                }
+                else if (arg == "--bypass-driver")
+                {
+                    Execution.BypassDriver = true;
+                }
+                else if (arg == "-v" || arg == "--verbose")
+                {
+                    Execution.Verbose = true;
+                }
+                else if (arg == "--max-load" && (kArgc - kIndex) >= 1ul)
+                {
+                    Execution.MaxLoad = std::strtod(ppArgv[kOffset + kIndex++], nullptr);
+                }
+                else if (arg == "--max-pressure" && (kArgc - kIndex) >= 1ul)
+                {
+                    Execution.MaxCpuPressure = std::strtod(ppArgv[kOffset + kIndex++], nullptr);
+                }
+                else if (arg == "query" && (kArgc - kIndex) >= 2ul)
+                {
+                    Query = ppArgv[kOffset + kIndex++];
+                    if (std::string_view{ Query } != "rdeps")
+                    {
+                        ShowHelpMessage("Query `%s` is unknown", Query);
+                        WksXmlFilepath = nullptr; // Don't build instead
+                        break;
+                    }
+                    // The rest are its files
+                    while (kIndex < kArgc)
+                    {
+                        QueryArgs.push_back(ppArgv[kOffset + kIndex++]);
+                    }
+                }
                 else
                 {
                     // Error
@@ -132,582 +240,5748 @@ namespace Cbuild
     {
         CommandProcessFailed = -69,
         WksBuildFailed = -70,
+        BuildInterrupted = -71,
     };
 
 }
 
 
-namespace Cbuild::Builders
+namespace Cbuild::Utils
 {
 
-    class ConsoleAppBuilder : public IProjectBuilder
+    // 64-bit FNV-1a, fed incrementally
+    struct Fnv1a
     {
-    public:
-        inline ConsoleAppBuilder(const Project* pProject)
+        uint64_t Value = 0xcbf29ce484222325ull;
+
+        inline void Add(const void* pData, size_t Size) noexcept
         {
-            m_Project = pProject;
+            const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+            for (size_t kIndex = 0; kIndex < Size; kIndex++)
+            {
+                Value = (Value ^ pBytes[kIndex]) * 0x100000001b3ull;
+            }
         }
 
-        inline virtual ~ConsoleAppBuilder() noexcept override = default;
+        inline void Add(const std::string_view& Text) noexcept
+        {
+            Add(Text.data(), Text.size());
+            Add("", 1); // Separator, so that {"ab","c"} and {"a","bc"} differ
+        }
+    };
+
 
-        virtual int32_t Build(const char* lpConfiguration) noexcept override
+    // "dir/name.ext" -> "dir/name.tmp.ext" (the extension is kept, some toolchains go by it)
+    static std::string MakeTemporaryFilepath(const std::string& Filepath) noexcept
+    {
+        const size_t kSeparator = Filepath.find_last_of("/\\");
+        const size_t kDot = Filepath.rfind('.');
+        if (kDot == std::string::npos || (kSeparator != std::string::npos && kDot < kSeparator))
         {
-            CBUILD_ASSERT(!m_Project->Configurations.empty(), "No configurations defined!");
-            CBUILD_ASSERT(lpConfiguration && *lpConfiguration, "Invalid configuration");
+            return Filepath + ".tmp";
+        }
+        return Filepath.substr(0, kDot) + ".tmp" + Filepath.substr(kDot);
+    }
 
-            const auto it = m_Project->Configurations.find({ lpConfiguration });
-            if (it == m_Project->Configurations.end())
-            {
-                printf("[ERROR]: Configuration `%s` was not found (check if it was defined and try again)\n", lpConfiguration);
-                return BuildResult::CommandProcessFailed;
-            }
 
-            const Configuration& config = it->second;
-            const std::string outputFilename = std::format("{}\\{}\\{}.exe", m_Project->Wks->OutputDir, lpConfiguration, m_Project->Name);
+    // Absolute and lexically normal, so that a file has one spelling however it was named ("./a/../b.h" -> "<cwd>/b.h")
+    static std::string MakeNormalFilepath(const std::string& Filepath) noexcept
+    {
+        namespace stdfs = std::filesystem;
 
-            const auto PrepareBaseCommand = [this, &config]() -> Command
-            {
-                // <CC> (-D <DEF> ...) (-I <INC> ...) (-L <LIBDIR> ...) (-l <LIB> ...) (<OPTS> ...) (<IN> ...)
-                Command cmd = { .Name = m_Project->Compiler };
+        std::error_code ec = {};
+        const stdfs::path path = stdfs::absolute(Filepath, ec);
+        return (ec ? stdfs::path{ Filepath } : path).lexically_normal().string();
+    }
 
-                // Defines
-                for (const auto& def : m_Project->Defines)
-                {
-                    cmd.Args.push_back("-D" + def);
-                }
-                for (const auto& def : config.Defines)
-                {
-                    cmd.Args.push_back("-D" + def);
-                }
-                // Includes
-                for (const auto& inc : m_Project->IncludeDirs)
-                {
-                    cmd.Args.push_back("-I" + inc);
-                }
-                // Options
-                if (m_Project->Arch.size() && m_Project->Arch == "x64")
-                {
-                    cmd.Args.push_back("-m64");
-                }
-                if (m_Project->Language == "C++")
-                {
-                    cmd.Args.push_back("-std=c++" + m_Project->CppVersion);
-                }
-                else
-                {
-                    cmd.Args.push_back("-std=c" + m_Project->CVersion);
-                }
-                for (const auto& flag : config.Flags)
+
+    // For maps keyed by strings of one loaded workspace model, which `Workspace::Load` interns:
+    // equal strings share their data, so they compare and hash by pointer
+    struct InternedHash
+    {
+        size_t operator()(std::string_view Value) const noexcept
+        {
+            return std::hash<const void*>{}(Value.data()) ^ Value.size();
+        }
+    };
+
+    struct InternedEqual
+    {
+        bool operator()(std::string_view Lhs, std::string_view Rhs) const noexcept
+        {
+            return Lhs.data() == Rhs.data() && Lhs.size() == Rhs.size();
+        }
+    };
+
+}
+
+
+namespace Cbuild::Platform
+{
+
+#if defined(CBUILD_LINUX)
+    // Reads the first number in a file (e.g. cgroup limits); false if missing or "max"
+    static bool ReadFileU64(const char* lpFilepath, uint64_t* pValue) noexcept
+    {
+        FILE* pFile = fopen(lpFilepath, "r");
+        if (!pFile)
+        {
+            return false;
+        }
+
+        unsigned long long kValue = 0;
+        const bool bRead = fscanf(pFile, "%llu", &kValue) == 1;
+        fclose(pFile);
+
+        *pValue = kValue;
+        return bRead;
+    }
+
+    // Ctrl-C, SIGTERM, SIGHUP and SIGCHLD: taken through the executor's signalfd, so blocked in every thread
+    // (main blocks them before starting any) and restored to their defaults in the processes it spawns
+    static sigset_t GetInterruptSignals() noexcept
+    {
+        sigset_t signals = {};
+        sigemptyset(&signals);
+        for (const int iSignal : { SIGINT, SIGTERM, SIGHUP, SIGCHLD })
+        {
+            sigaddset(&signals, iSignal);
+        }
+        return signals;
+    }
+
+    static bool AreInterruptSignalsBlocked() noexcept
+    {
+        sigset_t mask = {};
+        pthread_sigmask(SIG_BLOCK, nullptr, &mask);
+        return sigismember(&mask, SIGINT) == 1 && sigismember(&mask, SIGTERM) == 1 && sigismember(&mask, SIGHUP) == 1;
+    }
+#endif // CBUILD_LINUX
+
+    // Memory that can still be committed to jobs: MemAvailable, capped by the headroom left
+    // under the cgroup (v2, then v1) memory limit. 0 if unknown.
+    static uint64_t GetAvailableMemoryKb() noexcept
+    {
+#if defined(CBUILD_LINUX)
+        uint64_t availableKb = 0;
+        if (FILE* pFile = fopen("/proc/meminfo", "r"))
+        {
+            char line[256] = {};
+            while (fgets(line, sizeof(line), pFile))
+            {
+                unsigned long long kValue = 0;
+                if (sscanf(line, "MemAvailable: %llu kB", &kValue) == 1)
                 {
-                    cmd.Args.push_back("-" + flag);
+                    availableKb = kValue;
+                    break;
                 }
-                
-                return cmd;
-            };
+            }
+            fclose(pFile);
+        }
 
-            const auto PrepareFinalBuildCommand = [this, &outputFilename]() -> void
+        static const char* const s_CgroupFiles[][2] =
+        {
+            { "/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory.current" },
+            { "/sys/fs/cgroup/memory/memory.limit_in_bytes", "/sys/fs/cgroup/memory/memory.usage_in_bytes" },
+        };
+        for (const auto& files : s_CgroupFiles)
+        {
+            uint64_t limit = 0, usage = 0;
+            if (ReadFileU64(files[0], &limit))
+            {
+                ReadFileU64(files[1], &usage);
+                const uint64_t kHeadroomKb = limit > usage ? (limit - usage) / 1024ull : 0ull;
+                availableKb = availableKb ? std::min(availableKb, kHeadroomKb) : kHeadroomKb;
+                break;
+            }
+        }
+
+        return availableKb;
+#else
+        return 0;
+#endif // CBUILD_LINUX
+    }
+
+    // CPUs this process may actually use: the affinity mask, capped by the cgroup CPU quota
+    // (which containers usually set far below what the host reports)
+    static uint32_t GetCpuCount() noexcept
+    {
+        uint32_t kCpus = std::max(1u, std::thread::hardware_concurrency());
+#if defined(CBUILD_LINUX)
+        cpu_set_t set = {};
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        {
+            kCpus = std::max(1, CPU_COUNT(&set));
+        }
+
+        // cgroup v2: "<quota> <period>" or "max <period>"
+        unsigned long long kQuota = 0, kPeriod = 0;
+        if (FILE* pFile = fopen("/sys/fs/cgroup/cpu.max", "r"))
+        {
+            if (fscanf(pFile, "%llu %llu", &kQuota, &kPeriod) != 2)
+            {
+                kQuota = kPeriod = 0;
+            }
+            fclose(pFile);
+        }
+        else
+        {
+            // cgroup v1. A quota of -1 means unlimited; "%llu" accepts it as ULLONG_MAX, so the signed check is what skips it
+            uint64_t quota = 0, period = 0;
+            if (ReadFileU64("/sys/fs/cgroup/cpu/cpu.cfs_period_us", &period) && ReadFileU64("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", &quota) && (int64_t)quota > 0)
             {
-                Command buildConsoleAppCmd{ .Name = m_Project->Compiler };
+                kQuota = quota;
+                kPeriod = period;
+            }
+        }
 
-                // For console apps (executables), we link to the libraries when building the actual .exe file
-                // Intermediate Files
-                for (const auto& obj : m_OutputFiles)
-                {
-                    buildConsoleAppCmd.Args.push_back(obj);
-                }
-                // Library & References
-                for (const auto& libdir : m_Project->LibraryDirs)
+        if (kQuota && kPeriod)
+        {
+            kCpus = std::min(kCpus, (uint32_t)std::max(1ull, (kQuota + kPeriod - 1ull) / kPeriod));
+        }
+#endif // CBUILD_LINUX
+        return kCpus;
+    }
+
+    // True while the system is busier than the given limits (0 = no limit)
+    static bool IsOverloaded(double MaxLoad, double MaxCpuPressure) noexcept
+    {
+#if defined(CBUILD_LINUX)
+        if (MaxLoad > 0.0)
+        {
+            double load = 0.0;
+            if (FILE* pFile = fopen("/proc/loadavg", "r"))
+            {
+                const bool bRead = fscanf(pFile, "%lf", &load) == 1;
+                fclose(pFile);
+                if (bRead && load > MaxLoad)
                 {
-                    buildConsoleAppCmd.Args.push_back("-L" + libdir);
+                    return true;
                 }
-                for (const auto& ref : m_Project->References)
+            }
+        }
+
+        if (MaxCpuPressure > 0.0)
+        {
+            double pressure = 0.0;
+            if (FILE* pFile = fopen("/proc/pressure/cpu", "r"))
+            {
+                const bool bRead = fscanf(pFile, "some avg10=%lf", &pressure) == 1;
+                fclose(pFile);
+                if (bRead && pressure > MaxCpuPressure)
                 {
-                    buildConsoleAppCmd.Args.push_back("-l" + ref);
+                    return true;
                 }
-                // Output
-                buildConsoleAppCmd.Args.push_back("-o");
-                buildConsoleAppCmd.Args.push_back(outputFilename);
-                
-                m_Commands.push_back(buildConsoleAppCmd);
-                m_OutputFiles.push_back(outputFilename);
-            };
+            }
+        }
+#else
+        (void)MaxLoad, (void)MaxCpuPressure;
+#endif // CBUILD_LINUX
+        return false;
+    }
+
+    // Last modification time of a file (ns since the epoch), false if it can't be stat'ed. Only the mtime
+    // is asked for, which spares network file systems from fetching (or revalidating) the rest.
+    static bool GetModifiedTime(const char* lpFilepath, int64_t* pTimeNs) noexcept
+    {
+#if defined(CBUILD_WIN32)
+        WIN32_FILE_ATTRIBUTE_DATA data = {};
+        if (!GetFileAttributesExA(lpFilepath, GetFileExInfoStandard, &data))
+        {
+            return false;
+        }
+        // 100ns ticks since 1601
+        const uint64_t kTicks = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+        *pTimeNs = ((int64_t)kTicks - 116444736000000000ll) * 100ll;
+        return true;
+#elif defined(CBUILD_LINUX)
+        struct statx stx = {};
+        if (statx(AT_FDCWD, lpFilepath, 0, STATX_MTIME, &stx) != 0 || !(stx.stx_mask & STATX_MTIME))
+        {
+            return false;
+        }
+        *pTimeNs = stx.stx_mtime.tv_sec * 1000000000ll + stx.stx_mtime.tv_nsec;
+        return true;
+#endif // CBUILD_WIN32
+    }
+
+
+    // Read-only view of a whole file (an empty file opens fine, with no data). Opened copy-on-write,
+    // it can be written to (e.g. parsed in place) without changing the file.
+    class MappedFile
+    {
+    public:
+        MappedFile() noexcept = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile() noexcept
+        {
+            Close();
+        }
 
-            const auto BuildApp = [this]() -> int32_t
+        bool Open(const char* lpFilepath, bool bCopyOnWrite = false) noexcept
+        {
+            Close();
+#if defined(CBUILD_WIN32)
+            const HANDLE hFile = CreateFileA(lpFilepath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (hFile == INVALID_HANDLE_VALUE)
             {
-                List<std::string> cmdLines;
-                cmdLines.reserve(m_Commands.size());
+                return false;
+            }
 
-                for (const auto& cmd : m_Commands)
+            bool bOpened = false;
+            LARGE_INTEGER size = {};
+            if (GetFileSizeEx(hFile, &size))
+            {
+                bOpened = size.QuadPart == 0;
+                if (const HANDLE hMapping = !bOpened ? CreateFileMappingA(hFile, nullptr, bCopyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr) : nullptr)
                 {
-                    std::ostringstream oss;
-                    oss << cmd.Name;
-                    for (const auto& arg : cmd.Args)
-                    {
-                        oss << " " << arg;
-                    }
-                    cmdLines.push_back(oss.str());
+                    m_Data = MapViewOfFile(hMapping, bCopyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+                    m_Size = m_Data ? (size_t)size.QuadPart : 0;
+                    bOpened = m_Data != nullptr;
+                    CloseHandle(hMapping);
                 }
+            }
+            CloseHandle(hFile);
+            return bOpened;
+#elif defined(CBUILD_LINUX)
+            const int fd = open(lpFilepath, O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                return false;
+            }
 
-                BuildResult br = (BuildResult)0;
-                for (const auto& cmdline : cmdLines)
+            bool bOpened = false;
+            struct stat st = {};
+            if (fstat(fd, &st) == 0)
+            {
+                bOpened = st.st_size == 0;
+                if (!bOpened)
                 {
-                    printf("%s\n", cmdline.c_str());
-                    if (system(cmdline.c_str()) != 0)
+                    void* pView = mmap(nullptr, (size_t)st.st_size, bCopyOnWrite ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (pView != MAP_FAILED)
                     {
-                        br = BuildResult::WksBuildFailed;
+                        m_Data = pView;
+                        m_Size = (size_t)st.st_size;
+                        bOpened = true;
                     }
                 }
+            }
+            close(fd);
+            return bOpened;
+#endif // CBUILD_WIN32
+        }
 
-                return br;
-            };
+        void Close() noexcept
+        {
+            if (m_Data)
+            {
+#if defined(CBUILD_WIN32)
+                UnmapViewOfFile(m_Data);
+#elif defined(CBUILD_LINUX)
+                munmap(m_Data, m_Size);
+#endif // CBUILD_WIN32
+            }
+            m_Data = nullptr;
+            m_Size = 0;
+        }
 
-            GenerateBuildCommandsAndOutputFiles(lpConfiguration, PrepareBaseCommand());
-            PrepareFinalBuildCommand();
+        const uint8_t* GetData() const noexcept { return static_cast<const uint8_t*>(m_Data); }
+        uint8_t* GetData() noexcept { return static_cast<uint8_t*>(m_Data); } // Only writable when opened copy-on-write
+        size_t GetSize() const noexcept { return m_Size; }
 
-            return BuildApp();
-        }
+    private:
+        void* m_Data = nullptr;
+        size_t m_Size = 0;
     };
 
+}
+
 
-    class LibraryBuilder : public IProjectBuilder
+namespace Cbuild::Tasks
+{
+
+    class TaskGroup;
+
+
+    // Work-stealing pool for cbuild's own CPU (and file system) work, apart from the job slots of the
+    // compilers it runs. Each worker has a deque: it takes its newest task first (still warm in its cache),
+    // idle workers steal the oldest ones of the others. One worker less than there are usable CPUs (the
+    // thread waiting for a group helps run its tasks), and those at a lower priority, so that the pool only
+    // gets the CPU time compilers leave.
+    class ThreadPool
     {
     public:
-        inline LibraryBuilder(const Project* pProject)
+        inline ThreadPool(uint32_t Workers) noexcept
+            : m_Queues(Workers + 1ull) // The last one is for tasks from other threads
         {
-            m_Project = pProject;
+            for (uint32_t kIndex = 0; kIndex < Workers; kIndex++)
+            {
+                m_Threads.emplace_back([this, kIndex]() -> void { WorkerMain(kIndex); });
+            }
         }
 
-        inline virtual ~LibraryBuilder() noexcept override = default;
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
 
-        virtual int32_t Build(const char* lpConfiguration) noexcept override
+        inline ~ThreadPool() noexcept
         {
-            CBUILD_ASSERT(!m_Project->Configurations.empty(), "No configurations defined!");
-            CBUILD_ASSERT(lpConfiguration && *lpConfiguration, "Invalid configuration");
-
-            const auto it = m_Project->Configurations.find({ lpConfiguration });
-            if (it == m_Project->Configurations.end())
             {
-                printf("[ERROR]: Configuration `%s` was not found (check if it was defined and try again)\n", lpConfiguration);
-                return BuildResult::CommandProcessFailed;
+                std::lock_guard<std::mutex> lock{ m_Mutex };
+                m_Stop = true;
+            }
+            m_Wake.notify_all();
+            for (std::thread& thread : m_Threads)
+            {
+                thread.join();
             }
+        }
 
-            const Configuration& config = it->second;
-            const char* ext = m_Project->OutputKind == BuildOutputKind::StaticLibrary ? "lib" : CBUILD_SHARED_LIB_EXT;
-            const std::string outputDir = std::format("{}\\{}", m_Project->Wks->OutputDir, lpConfiguration);
-            const std::string outputFilename = std::format("{}\\{}.{}", outputDir , m_Project->Name, ext);
+        // Started the first time it's needed
+        static ThreadPool& Get() noexcept
+        {
+            static ThreadPool s_Pool{ Platform::GetCpuCount() - 1u };
+            return s_Pool;
+        }
 
-            const auto PrepareBaseCommand = [this, &config]() -> Command
+        uint32_t GetThreadCount() const noexcept
+        {
+            return (uint32_t)m_Threads.size() + 1u;
+        }
+
+    private:
+        friend class TaskGroup;
+
+        struct Task
+        {
+            std::function<void()> Fn = {};
+            TaskGroup* Group = nullptr;
+        };
+
+        struct Queue
+        {
+            std::mutex Mutex = {};
+            std::deque<Task> Tasks = {};
+        };
+
+        void Push(Task&& T) noexcept
+        {
+            Queue& queue = m_Queues[t_Pool == this ? t_Worker : m_Queues.size() - 1ull];
             {
-                // <CC> (-D <DEF> ...) (-I <INC> ...) (-L <LIBDIR> ...) (-l <LIB> ...) (<OPTS> ...) (<IN> ...)
-                Command cmd = { .Name = m_Project->Compiler };
+                std::lock_guard<std::mutex> lock{ queue.Mutex };
+                queue.Tasks.push_back(std::move(T));
+            }
+            m_Queued++;
+            {
+                std::lock_guard<std::mutex> lock{ m_Mutex };
+            }
+            m_Wake.notify_one();
+        }
 
-                // Defines
-                for (const auto& def : m_Project->Defines)
+        // Runs one task: the newest of this worker's own, or else the oldest of another queue. False if there was none.
+        bool RunOne() noexcept
+        {
+            Task task = {};
+            const size_t kSelf = t_Pool == this ? t_Worker : m_Queues.size() - 1ull;
+            bool bFound = false;
+            for (size_t kOffset = 0; kOffset < m_Queues.size() && !bFound; kOffset++)
+            {
+                Queue& queue = m_Queues[(kSelf + kOffset) % m_Queues.size()];
+                std::lock_guard<std::mutex> lock{ queue.Mutex };
+                if (!queue.Tasks.empty())
                 {
-                    cmd.Args.push_back("-D" + def);
+                    if (kOffset == 0 && t_Pool == this)
+                    {
+                        task = std::move(queue.Tasks.back());
+                        queue.Tasks.pop_back();
+                    }
+                    else
+                    {
+                        task = std::move(queue.Tasks.front());
+                        queue.Tasks.pop_front();
+                    }
+                    bFound = true;
+                }
+            }
+            if (!bFound)
+            {
+                return false;
+            }
+
+            m_Queued--;
+            task.Fn();
+            Finish(task.Group);
+            return true;
+        }
+
+        void Finish(TaskGroup* pGroup) noexcept;
+
+        // Until the predicate holds, runs tasks (or sleeps while there are none)
+        template<typename P>
+        void HelpUntil(P&& Predicate) noexcept
+        {
+            while (!Predicate())
+            {
+                if (!RunOne())
+                {
+                    std::unique_lock<std::mutex> lock{ m_Mutex };
+                    m_Wake.wait(lock, [&]() -> bool { return m_Stop || m_Queued > 0 || Predicate(); });
+                    if (m_Stop)
+                    {
+                        return;
+                    }
+                }
+            }
+        }
+
+        void WorkerMain(uint32_t Index) noexcept
+        {
+            t_Pool = this;
+            t_Worker = Index;
+#if defined(CBUILD_WIN32)
+            SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(CBUILD_LINUX)
+            setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10); // Per thread on Linux
+            CBUILD_ASSERT(Platform::AreInterruptSignalsBlocked(), "The task pool was started before main blocked the interrupt signals");
+#endif // CBUILD_WIN32
+            HelpUntil([]() -> bool { return false; });
+        }
+
+    private:
+        List<Queue> m_Queues;
+        List<std::thread> m_Threads = {};
+        std::atomic<size_t> m_Queued = 0; // Tasks in the queues
+        std::mutex m_Mutex = {}; // For sleeping on `m_Wake`
+        std::condition_variable m_Wake = {};
+        bool m_Stop = false;
+
+        static inline thread_local ThreadPool* t_Pool = nullptr; // The pool the thread works for
+        static inline thread_local uint32_t t_Worker = 0;
+    };
+
+
+    // Tasks that are waited for together. Waiting runs tasks (the group's or others) instead of blocking.
+    class TaskGroup
+    {
+    public:
+        inline TaskGroup(ThreadPool& Pool = ThreadPool::Get()) noexcept
+            : m_Pool{ Pool }
+        { }
+
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        inline ~TaskGroup() noexcept
+        {
+            Wait();
+        }
+
+        void Run(std::function<void()>&& Fn) noexcept
+        {
+            m_Pending++;
+            m_Pool.Push({ std::move(Fn), this });
+        }
+
+        void Wait() noexcept
+        {
+            m_Pool.HelpUntil([this]() -> bool { return m_Pending == 0; });
+        }
+
+    private:
+        friend class ThreadPool;
+
+        ThreadPool& m_Pool;
+        std::atomic<size_t> m_Pending = 0;
+    };
+
+
+    inline void ThreadPool::Finish(TaskGroup* pGroup) noexcept
+    {
+        // The group may be gone as soon as its count reaches 0 (its owner doesn't wait for the lock), so it isn't touched after
+        if (--pGroup->m_Pending == 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock{ m_Mutex };
+            }
+            m_Wake.notify_all();
+        }
+    }
+
+
+    // Calls `Fn(Begin, End)` for chunks of [0, Count), on the pool. Runs inline when there is only one chunk.
+    template<typename F>
+    static void ParallelFor(size_t Count, size_t Grain, F&& Fn) noexcept
+    {
+        if (Count <= Grain || ThreadPool::Get().GetThreadCount() == 1u)
+        {
+            if (Count)
+            {
+                Fn((size_t)0, Count);
+            }
+            return;
+        }
+
+        TaskGroup group = {};
+        for (size_t kBegin = 0; kBegin < Count; kBegin += Grain)
+        {
+            group.Run([&Fn, kBegin, kEnd = std::min(Count, kBegin + Grain)]() -> void { Fn(kBegin, kEnd); });
+        }
+        group.Wait();
+    }
+
+}
+
+
+namespace Cbuild::Exec
+{
+
+    // Per-node statistics kept across builds (keyed by output file)
+    struct NodeRecord
+    {
+        uint32_t DurationMs = 0;
+        uint64_t PeakRssKb = 0;
+        uint64_t ResponseFileHash = 0; // Of the arguments last written to the node's response file
+        uint64_t CommandHash = 0; // Of the command that last built the node successfully
+        List<uint32_t> Headers = {}; // Read by the node's last successful build (from its depfile, see BuildDatabase::GetHeader)
+    };
+
+
+    // The include directives of a file, as last read by the include scanner (`"name` or `<name`)
+    struct ScanRecord
+    {
+        int64_t ModifiedTime = 0; // Of the file when it was read
+        List<std::string> Includes = {};
+    };
+
+
+    class BuildDatabase
+    {
+    public:
+        static inline constexpr const char* const Filename = ".cbuild_db";
+        static inline constexpr const char* const Header = "CBUILDDB 5";
+
+        inline BuildDatabase() noexcept = default;
+        BuildDatabase(const BuildDatabase&) = delete;
+        BuildDatabase& operator=(const BuildDatabase&) = delete;
+
+        inline ~BuildDatabase() noexcept
+        {
+            CloseJournal();
+        }
+
+        // A snapshot of all records, followed by the records journaled since (later lines win)
+        bool Load(const std::string& Filepath) noexcept
+        {
+            m_Filepath = Filepath;
+            m_Nodes.clear();
+            m_Headers.clear();
+            m_HeaderIds.clear();
+            m_Scans.clear();
+            m_Truncated = false;
+
+            std::ifstream ifs{ Filepath };
+            std::string line = {};
+            if (!ifs || !std::getline(ifs, line) || line != Header)
+            {
+                return false;
+            }
+
+            // H <TAB> <Header>  (the header's ID is its position among these lines)
+            // I <TAB> <Header ID> <TAB> <ModifiedTime> (<TAB> <Include>)...
+            // <DurationMs> <TAB> <PeakRssKb> <TAB> <ResponseFileHash> <TAB> <CommandHash> <TAB> <Header IDs, comma separated, or -> <TAB> <Output>
+            while (std::getline(ifs, line))
+            {
+                if (ifs.eof())
+                {
+                    m_Truncated = true; // No newline: the journal write was cut short
+                    break;
+                }
+
+                if (line.starts_with("H\t"))
+                {
+                    InternHeader(std::string_view{ line }.substr(2ull));
+                    continue;
+                }
+
+                if (line.starts_with("I\t"))
+                {
+                    uint32_t kId = 0;
+                    long long iModifiedTime = 0;
+                    int iIncludesOffset = 0;
+                    if (sscanf(line.c_str() + 2, "%u\t%lld%n", &kId, &iModifiedTime, &iIncludesOffset) == 2 && kId < m_Headers.size())
+                    {
+                        ScanRecord& scan = m_Scans[kId];
+                        scan.ModifiedTime = iModifiedTime;
+                        scan.Includes.clear();
+                        for (size_t kPos = 2ull + (size_t)iIncludesOffset; kPos < line.size();)
+                        {
+                            const size_t kEnd = std::min(line.find('\t', kPos + 1ull), line.size());
+                            scan.Includes.push_back(line.substr(kPos + 1ull, kEnd - kPos - 1ull));
+                            kPos = kEnd;
+                        }
+                    }
+                    continue;
+                }
+
+                NodeRecord record = {};
+                unsigned long long kPeakRssKb = 0, kResponseFileHash = 0, kCommandHash = 0;
+                int iHeadersOffset = 0;
+                if (sscanf(line.c_str(), "%u\t%llu\t%llx\t%llx\t%n", &record.DurationMs, &kPeakRssKb, &kResponseFileHash, &kCommandHash, &iHeadersOffset) != 4 || !iHeadersOffset)
+                {
+                    continue;
+                }
+
+                const size_t kOutputOffset = line.find('\t', (size_t)iHeadersOffset);
+                if (kOutputOffset == std::string::npos || !ParseHeaderIds(std::string_view{ line }.substr((size_t)iHeadersOffset, kOutputOffset - (size_t)iHeadersOffset), record.Headers))
+                {
+                    continue;
+                }
+
+                record.PeakRssKb = kPeakRssKb;
+                record.ResponseFileHash = kResponseFileHash;
+                record.CommandHash = kCommandHash;
+                m_Nodes[line.substr(kOutputOffset + 1ull)] = std::move(record);
+            }
+
+            // Only the headers each node read are stored, the nodes that read each header are derived from them
+            m_Includers.assign(m_Headers.size(), {});
+            for (const auto& [output, record] : m_Nodes)
+            {
+                for (const uint32_t kHeader : record.Headers)
+                {
+                    m_Includers[kHeader].push_back(&output);
+                }
+            }
+
+            m_JournaledHeaders = m_Headers.size();
+            return true;
+        }
+
+        // Rewrites the snapshot (compacting the journal)
+        bool Save() noexcept
+        {
+            namespace stdfs = std::filesystem;
+
+            CloseJournal();
+
+            std::error_code ec = {};
+            const stdfs::path path{ m_Filepath };
+            if (path.has_parent_path())
+            {
+                stdfs::create_directories(path.parent_path(), ec);
+            }
+
+            // Written to a temporary file first, so an interrupted save never leaves a truncated database
+            const std::string tmpFilepath = m_Filepath + ".tmp";
+            {
+                std::ofstream ofs{ tmpFilepath, std::ios::trunc };
+                if (!ofs)
+                {
+                    return false;
+                }
+
+                ofs << Header << '\n';
+                for (const std::string& header : m_Headers)
+                {
+                    ofs << "H\t" << header << '\n';
+                }
+                for (const auto& [output, record] : m_Nodes)
+                {
+                    ofs << FormatRecord(output, record);
+                }
+                for (const auto& [kId, scan] : m_Scans)
+                {
+                    ofs << "I\t" << kId << '\t' << scan.ModifiedTime;
+                    for (const std::string& include : scan.Includes)
+                    {
+                        ofs << '\t' << include;
+                    }
+                    ofs << '\n';
+                }
+            }
+
+            stdfs::rename(tmpFilepath, path, ec);
+            if (ec)
+            {
+                return false;
+            }
+
+            m_JournaledHeaders = m_Headers.size();
+            m_Truncated = false;
+            return true;
+        }
+
+        // Appends the node's current record to the database right away, so it survives an interrupted build
+        void Journal(const std::string& Output) noexcept
+        {
+            if (!m_Journal)
+            {
+                // Appending to a line that was cut short would garble both, and shift the IDs of the headers after it
+                if (m_Truncated && !Save())
+                {
+                    return;
+                }
+
+                m_Journal = fopen(m_Filepath.c_str(), "ab");
+                if (!m_Journal)
+                {
+                    return;
+                }
+                setvbuf(m_Journal, nullptr, _IONBF, 0); // One write per record
+            }
+
+            // Along with the headers the file doesn't know yet (before the record that refers to them)
+            std::string line = {};
+            for (; m_JournaledHeaders < m_Headers.size(); m_JournaledHeaders++)
+            {
+                line.append("H\t").append(m_Headers[m_JournaledHeaders]).push_back('\n');
+            }
+            line += FormatRecord(Output, m_Nodes[Output]);
+            fwrite(line.data(), 1, line.size(), m_Journal);
+        }
+
+        const NodeRecord* Find(const std::string& Output) const noexcept
+        {
+            const auto it = m_Nodes.find(Output);
+            return it != m_Nodes.end() ? &it->second : nullptr;
+        }
+
+        // The node's record, created if it does not exist yet
+        NodeRecord& Touch(const std::string& Output) noexcept
+        {
+            return m_Nodes[Output];
+        }
+
+        // Replaces the headers the node read, keeping the reverse index (header -> nodes) up to date
+        template<typename S>
+        void SetHeaders(const std::string& Output, const List<S>& Headers) noexcept
+        {
+            List<uint32_t> ids = {};
+            ids.reserve(Headers.size());
+            for (const std::string_view header : Headers)
+            {
+                ids.push_back(InternHeader(header));
+            }
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+            const auto it = m_Nodes.try_emplace(Output).first;
+            NodeRecord& record = it->second;
+            if (record.Headers == ids)
+            {
+                return; // The usual case, a rebuild rarely changes what a source includes
+            }
+
+            for (const uint32_t kHeader : record.Headers)
+            {
+                List<const std::string*>& includers = m_Includers[kHeader];
+                const auto itIncluder = std::find(includers.begin(), includers.end(), &it->first);
+                if (itIncluder != includers.end())
+                {
+                    *itIncluder = includers.back();
+                    includers.pop_back();
+                }
+            }
+            for (const uint32_t kHeader : ids)
+            {
+                m_Includers[kHeader].push_back(&it->first);
+            }
+            record.Headers = std::move(ids);
+        }
+
+        const std::string& GetHeader(uint32_t Id) const noexcept
+        {
+            return m_Headers[Id];
+        }
+
+        size_t GetHeaderCount() const noexcept
+        {
+            return m_Headers.size();
+        }
+
+        // Scanned include directives, by file (only written by `Save`, they can always be scanned again)
+        void SetScan(const std::string& Filepath, const ScanRecord& Scan) noexcept
+        {
+            m_Scans[InternHeader(Filepath)] = Scan;
+        }
+
+        template<typename F>
+        void ForEachScan(F&& Fn) const noexcept
+        {
+            for (const auto& [kId, scan] : m_Scans)
+            {
+                Fn(m_Headers[kId], scan);
+            }
+        }
+
+        // Outputs of the nodes whose last build read the header (an absolute, normal path), without walking the nodes
+        const List<const std::string*>* FindIncluders(const std::string& Header) const noexcept
+        {
+            const auto it = m_HeaderIds.find(Header);
+            return it != m_HeaderIds.end() ? &m_Includers[it->second] : nullptr;
+        }
+
+    private:
+        static std::string FormatRecord(const std::string& Output, const NodeRecord& Record) noexcept
+        {
+            std::string headers = {};
+            for (const uint32_t kHeader : Record.Headers)
+            {
+                headers.append(headers.empty() ? "" : ",").append(std::to_string(kHeader));
+            }
+            return std::format("{}\t{}\t{:x}\t{:x}\t{}\t{}\n", Record.DurationMs, Record.PeakRssKb, Record.ResponseFileHash, Record.CommandHash,
+                headers.empty() ? "-" : headers, Output);
+        }
+
+        bool ParseHeaderIds(std::string_view Field, List<uint32_t>& Ids) const noexcept
+        {
+            if (Field == "-")
+            {
+                return true;
+            }
+
+            while (!Field.empty())
+            {
+                uint32_t kId = 0;
+                const auto [pEnd, ec] = std::from_chars(Field.data(), Field.data() + Field.size(), kId);
+                if (ec != std::errc{} || kId >= m_Headers.size())
+                {
+                    return false;
+                }
+                Ids.push_back(kId);
+                Field.remove_prefix((size_t)(pEnd - Field.data()));
+                if (!Field.empty())
+                {
+                    if (Field.front() != ',')
+                    {
+                        return false;
+                    }
+                    Field.remove_prefix(1ull);
+                }
+            }
+            return true;
+        }
+
+        uint32_t InternHeader(std::string_view Header) noexcept
+        {
+            const auto [it, bInserted] = m_HeaderIds.try_emplace(std::string{ Header }, (uint32_t)m_Headers.size());
+            if (bInserted)
+            {
+                m_Headers.emplace_back(Header);
+                m_Includers.emplace_back();
+            }
+            return it->second;
+        }
+
+        void CloseJournal() noexcept
+        {
+            if (m_Journal)
+            {
+                fclose(m_Journal);
+                m_Journal = nullptr;
+            }
+        }
+
+    private:
+        std::string m_Filepath = {};
+        Dictionary<NodeRecord> m_Nodes = {};
+        List<std::string> m_Headers = {}; // By ID
+        Dictionary<uint32_t> m_HeaderIds = {};
+        List<List<const std::string*>> m_Includers = {}; // By header ID, into the keys of `m_Nodes`
+        Map<uint32_t, ScanRecord> m_Scans = {}; // By header ID (sources included)
+        size_t m_JournaledHeaders = 0; // Headers the file has lines for
+        FILE* m_Journal = nullptr;
+        bool m_Truncated = false; // The file ends with a line that was cut short
+    };
+
+
+    // The prerequisites of a depfile's (first) rule, i.e. the files the compile read, but its source.
+    // Paths are made normal, so that each file has one spelling in the database.
+    static List<std::string> ReadDepfile(const std::string& Filepath, const std::string& Source) noexcept
+    {
+        List<std::string> headers = {};
+        Platform::MappedFile file = {};
+        if (!file.Open(Filepath.c_str()))
+        {
+            return headers;
+        }
+
+        const std::string_view text{ (const char*)file.GetData(), file.GetSize() };
+        const std::string source = Utils::MakeNormalFilepath(Source);
+
+        // Skip the target (a `:` followed by a blank, so that drive letters are not mistaken for it)
+        const auto IsBlank = [](char c) -> bool { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; };
+        size_t kPos = 0;
+        while (kPos < text.size() && !(text[kPos] == ':' && (kPos + 1ull == text.size() || IsBlank(text[kPos + 1ull]))))
+        {
+            kPos++;
+        }
+        kPos++;
+
+        // Make syntax: blanks separate paths, `\` + newline continues the line, `\ ` is a space, `$$` is a `$`
+        std::string path = {};
+        const auto Flush = [&]() -> void
+        {
+            if (!path.empty())
+            {
+                std::string header = Utils::MakeNormalFilepath(path);
+                if (header != source)
+                {
+                    headers.push_back(std::move(header));
+                }
+                path.clear();
+            }
+        };
+        for (; kPos < text.size(); kPos++)
+        {
+            const char c = text[kPos];
+            const char next = kPos + 1ull < text.size() ? text[kPos + 1ull] : '\0';
+            if (c == '\\' && (next == '\n' || (next == '\r' && kPos + 2ull < text.size() && text[kPos + 2ull] == '\n')))
+            {
+                Flush();
+                kPos += next == '\r' ? 2ull : 1ull;
+            }
+            else if (c == '\\' && (next == ' ' || next == '#'))
+            {
+                path.push_back(next);
+                kPos++;
+            }
+            else if (c == '$' && next == '$')
+            {
+                path.push_back('$');
+                kPos++;
+            }
+            else if (c == '\n')
+            {
+                break; // End of the rule
+            }
+            else if (c == ' ' || c == '\t' || c == '\r')
+            {
+                Flush();
+            }
+            else
+            {
+                path.push_back(c);
+            }
+        }
+        Flush();
+
+        return headers;
+    }
+
+
+    // Finds the headers a source includes (transitively) without a compiler: `#include "..."` is looked up
+    // next to the including file, then in the command's -I directories, `#include <...>` only in the latter.
+    // Not a preprocessor: every branch of a conditional counts, includes of macros are skipped, and what is
+    // not found (system or yet to be generated headers) is left out, as -MMD does. Meant for sources that
+    // were never compiled, the depfile of their first compile replaces what it finds.
+    // Scans of each file are kept (by modification time) across sources, and across builds in the database.
+    // `Scan` may be called from several threads at once.
+    class IncludeScanner
+    {
+    public:
+        inline IncludeScanner(const BuildDatabase& Db) noexcept
+        {
+            Db.ForEachScan([this](const std::string& Filepath, const ScanRecord& Scan)
+            {
+                m_Files[InternFile(Filepath)].Scan = Scan;
+            });
+        }
+
+        // Normal paths (see Utils::MakeNormalFilepath) of the headers, the source left out. Valid as long as the scanner.
+        List<std::string_view> Scan(const Command& Cmd) noexcept
+        {
+            // Sources with the same -I directories share what their files' includes resolve to
+            std::string searchKey = {};
+            Cmd.ForEachArg([&searchKey](const std::string& arg)
+            {
+                if (arg.size() > 2ull && arg.starts_with("-I"))
+                {
+                    searchKey.append(Utils::MakeNormalFilepath(arg.substr(2ull))).push_back('\n');
+                }
+            });
+
+            uint32_t kSource = 0;
+            SearchPath* pSearchPath = nullptr;
+            {
+                std::lock_guard<std::mutex> lock{ m_Mutex };
+                kSource = InternFile(Utils::MakeNormalFilepath(Cmd.Input));
+                std::unique_ptr<SearchPath>& pEntry = m_SearchPaths[searchKey];
+                if (!pEntry)
+                {
+                    pEntry = std::make_unique<SearchPath>();
+                    for (size_t kPos = 0; kPos < searchKey.size();)
+                    {
+                        const size_t kEnd = searchKey.find('\n', kPos);
+                        pEntry->Dirs.push_back(searchKey.substr(kPos, kEnd - kPos));
+                        kPos = kEnd + 1ull;
+                    }
+                }
+                pSearchPath = pEntry.get();
+            }
+
+            List<uint32_t> headers = {};
+            List<uint8_t> visited(kSource + 1ull); // By file ID (files are interned as they are found)
+            visited[kSource] = 1;
+            List<uint32_t> stack{ kSource };
+            while (!stack.empty())
+            {
+                const uint32_t kFile = stack.back();
+                stack.pop_back();
+                for (const uint32_t kHeader : GetResolvedIncludes(*pSearchPath, kFile))
+                {
+                    if (kHeader >= visited.size())
+                    {
+                        visited.resize(kHeader * 2ull + 1ull);
+                    }
+                    if (!visited[kHeader])
+                    {
+                        visited[kHeader] = 1;
+                        headers.push_back(kHeader);
+                        stack.push_back(kHeader);
+                    }
+                }
+            }
+
+            List<std::string_view> filepaths = {};
+            filepaths.reserve(headers.size());
+            std::lock_guard<std::mutex> lock{ m_Mutex };
+            for (const uint32_t kHeader : headers)
+            {
+                filepaths.push_back(m_Files[kHeader].Path);
+            }
+            return filepaths;
+        }
+
+        // Keeps the scans that were (re)done in the database
+        void Store(BuildDatabase& Db) const noexcept
+        {
+            for (const File& file : m_Files)
+            {
+                if (file.Changed)
+                {
+                    Db.SetScan(file.Path, file.Scan);
+                }
+            }
+        }
+
+        size_t GetReadCount() const noexcept
+        {
+            return m_ReadCount;
+        }
+
+    private:
+        struct File
+        {
+            std::string Path = {};
+            ScanRecord Scan = {};
+            bool Checked = false; // Against the file's modification time, during this build (then `Scan` no longer changes)
+            bool Changed = false;
+        };
+
+        struct SearchPath
+        {
+            List<std::string> Dirs = {};
+            Map<uint32_t, List<uint32_t>> Includes = {}; // File -> the files its directives resolve to
+        };
+
+        uint32_t InternFile(const std::string& Filepath) noexcept
+        {
+            const auto [it, bInserted] = m_FileIds.try_emplace(Filepath, (uint32_t)m_Files.size());
+            if (bInserted)
+            {
+                m_Files.push_back({ .Path = Filepath });
+            }
+            return it->second;
+        }
+
+        const List<uint32_t>& GetResolvedIncludes(SearchPath& Search, uint32_t File) noexcept
+        {
+            std::string filepath = {};
+            {
+                std::lock_guard<std::mutex> lock{ m_Mutex };
+                if (const auto it = Search.Includes.find(File); it != Search.Includes.end())
+                {
+                    return it->second;
+                }
+                filepath = m_Files[File].Path;
+            }
+
+            // Unlocked, another thread may do the same meanwhile (the first one to finish wins)
+            const std::string_view dir = std::string_view{ filepath }.substr(0, filepath.find_last_of("/\\") + 1ull);
+            List<std::string> resolved = {};
+            for (const std::string& include : GetIncludes(File))
+            {
+                std::string header = Resolve(dir, include, Search.Dirs);
+                if (!header.empty())
+                {
+                    resolved.push_back(std::move(header));
+                }
+            }
+
+            std::lock_guard<std::mutex> lock{ m_Mutex };
+            List<uint32_t> ids = {};
+            for (const std::string& header : resolved)
+            {
+                ids.push_back(InternFile(header));
+            }
+            return Search.Includes.try_emplace(File, std::move(ids)).first->second;
+        }
+
+        // The file's directives, read again only if it changed since it was scanned
+        const List<std::string>& GetIncludes(uint32_t Id) noexcept
+        {
+            std::string filepath = {};
+            {
+                std::lock_guard<std::mutex> lock{ m_Mutex };
+                if (m_Files[Id].Checked)
+                {
+                    return m_Files[Id].Scan.Includes;
+                }
+                filepath = m_Files[Id].Path;
+            }
+
+            int64_t modifiedTime = 0;
+            const bool bExists = Platform::GetModifiedTime(filepath.c_str(), &modifiedTime);
+            std::unique_lock<std::mutex> lock{ m_Mutex };
+            if (!m_Files[Id].Checked && bExists && modifiedTime != m_Files[Id].Scan.ModifiedTime)
+            {
+                lock.unlock();
+                ScanRecord scan = { .ModifiedTime = modifiedTime };
+                Platform::MappedFile mapping = {};
+                if (mapping.Open(filepath.c_str()))
+                {
+                    ParseIncludes({ (const char*)mapping.GetData(), mapping.GetSize() }, scan.Includes);
+                }
+                lock.lock();
+
+                File& file = m_Files[Id];
+                if (!file.Checked)
+                {
+                    file.Changed = true;
+                    file.Scan = std::move(scan);
+                    m_ReadCount++;
+                }
+            }
+
+            File& file = m_Files[Id];
+            if (!bExists && !file.Checked)
+            {
+                file.Scan.Includes.clear(); // Gone (and not on any path taken anymore)
+            }
+            file.Checked = true;
+            return file.Scan.Includes;
+        }
+
+        // Where the directive's file is, or nothing if it isn't found
+        std::string Resolve(std::string_view Dir, const std::string& Include, const List<std::string>& Dirs) noexcept
+        {
+            const std::string_view name = std::string_view{ Include }.substr(1ull);
+            const auto Exists = [this](const std::string& Filepath) -> bool
+            {
+                {
+                    std::lock_guard<std::mutex> lock{ m_Mutex };
+                    if (const auto it = m_Exists.find(Filepath); it != m_Exists.end())
+                    {
+                        return it->second;
+                    }
+                }
+                int64_t modifiedTime = 0;
+                const bool bExists = Platform::GetModifiedTime(Filepath.c_str(), &modifiedTime);
+                std::lock_guard<std::mutex> lock{ m_Mutex };
+                m_Exists.emplace(Filepath, bExists);
+                return bExists;
+            };
+
+            if (Include.front() == '"')
+            {
+                std::string filepath = JoinFilepath(Dir, name);
+                if (Exists(filepath))
+                {
+                    return filepath;
+                }
+            }
+            for (const std::string& dir : Dirs)
+            {
+                std::string filepath = JoinFilepath(dir, name);
+                if (Exists(filepath))
+                {
+                    return filepath;
+                }
+            }
+            return {};
+        }
+
+        // `Dir` (normal already) + `Name`, normal. Most names have nothing to normalize, and are simply appended.
+        static std::string JoinFilepath(std::string_view Dir, std::string_view Name) noexcept
+        {
+            const bool bSimple = !Name.starts_with('/') && Name.find("./") == std::string_view::npos && Name.find('\\') == std::string_view::npos
+                && Name.find("//") == std::string_view::npos && Name.find(':') == std::string_view::npos;
+            if (!bSimple)
+            {
+                return (std::filesystem::path{ Dir } / Name).lexically_normal().string();
+            }
+
+            std::string filepath{ Dir };
+            if (!filepath.empty() && filepath.back() != '/' && filepath.back() != '\\')
+            {
+                filepath += CBUILD_PATH_SEP;
+            }
+            const size_t kNameOffset = filepath.size();
+            filepath += Name;
+            if constexpr (CBUILD_PATH_SEP[0] != '/')
+            {
+                std::replace(filepath.begin() + (ptrdiff_t)kNameOffset, filepath.end(), '/', CBUILD_PATH_SEP[0]);
+            }
+            return filepath;
+        }
+
+        // `#include` (and `#include_next`) directives, skipping comments, string and character literals.
+        // Runs of ordinary characters are skipped by a lookup table, comments and literals by searching for their end.
+        static void ParseIncludes(std::string_view Text, List<std::string>& Includes) noexcept
+        {
+            static constexpr auto s_Special = []() -> std::array<bool, 256>
+            {
+                std::array<bool, 256> special = {};
+                for (const unsigned char c : { '\n', '/', '"', '\'' })
+                {
+                    special[c] = true;
+                }
+                return special;
+            }();
+            const auto IsIdentifier = [](char c) -> bool
+            {
+                return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+            };
+
+            const size_t kSize = Text.size();
+            size_t kPos = 0;
+            bool bLineStart = true;
+            while (kPos < kSize)
+            {
+                if (bLineStart)
+                {
+                    bLineStart = false;
+                    kPos = Text.find_first_not_of(" \t\f\v\r", kPos);
+                    if (kPos == std::string_view::npos)
+                    {
+                        break;
+                    }
+                    if (Text[kPos] == '#')
+                    {
+                        kPos = ParseDirective(Text, kPos + 1ull, Includes);
+                        continue;
+                    }
+                }
+
+                while (kPos < kSize && !s_Special[(unsigned char)Text[kPos]])
+                {
+                    kPos++;
+                }
+                if (kPos >= kSize)
+                {
+                    break;
+                }
+
+                const char c = Text[kPos];
+                const char next = kPos + 1ull < kSize ? Text[kPos + 1ull] : '\0';
+                if (c == '\n')
+                {
+                    bLineStart = true;
+                    kPos++;
+                }
+                else if (c == '/' && next == '/')
+                {
+                    kPos = Text.find('\n', kPos); // The newline itself is a line start
+                }
+                else if (c == '/' && next == '*')
+                {
+                    const size_t kEnd = Text.find("*/", kPos + 2ull);
+                    kPos = kEnd == std::string_view::npos ? kSize : kEnd + 2ull;
+                }
+                else if (c == '"' && kPos > 0 && Text[kPos - 1ull] == 'R' && (kPos < 2ull || !IsIdentifier(Text[kPos - 2ull]) || std::string_view{ "uUL8" }.find(Text[kPos - 2ull]) != std::string_view::npos))
+                {
+                    // R"delimiter( ... )delimiter"
+                    const size_t kOpen = Text.find('(', kPos);
+                    if (kOpen == std::string_view::npos || kOpen - kPos > 17ull)
+                    {
+                        kPos++;
+                        continue;
+                    }
+                    const std::string terminator = std::format("){}\"", Text.substr(kPos + 1ull, kOpen - kPos - 1ull));
+                    const size_t kEnd = Text.find(terminator, kOpen);
+                    kPos = kEnd == std::string_view::npos ? kSize : kEnd + terminator.size();
+                }
+                else if (c == '"' || (c == '\'' && !(kPos > 0 && IsIdentifier(Text[kPos - 1ull])))) // Not a digit separator (1'000)
+                {
+                    // Up to the closing quote, or the end of the line if there is none
+                    for (kPos++; kPos < kSize && Text[kPos] != c && Text[kPos] != '\n'; kPos++)
+                    {
+                        if (Text[kPos] == '\\')
+                        {
+                            kPos++;
+                        }
+                    }
+                    if (kPos < kSize && Text[kPos] == c)
+                    {
+                        kPos++;
+                    }
+                }
+                else
+                {
+                    kPos++;
+                }
+            }
+        }
+
+        // From after the `#`. Returns where scanning goes on (after the header name of an include).
+        static size_t ParseDirective(std::string_view Text, size_t Pos, List<std::string>& Includes) noexcept
+        {
+            Pos = std::min(Text.find_first_not_of(" \t", Pos), Text.size());
+            if (Text.substr(Pos, 7ull) != "include")
+            {
+                return Pos;
+            }
+            Pos += Text.substr(Pos, 12ull) == "include_next" ? 12ull : 7ull;
+            Pos = std::min(Text.find_first_not_of(" \t", Pos), Text.size());
+            if (Pos >= Text.size() || (Text[Pos] != '"' && Text[Pos] != '<'))
+            {
+                return Pos; // Include of a macro
+            }
+
+            const size_t kEnd = Text.find_first_of(Text[Pos] == '"' ? "\"\n" : ">\n", Pos + 1ull);
+            if (kEnd == std::string_view::npos || Text[kEnd] == '\n' || kEnd == Pos + 1ull)
+            {
+                return Pos + 1ull;
+            }
+            Includes.emplace_back(Text.substr(Pos, kEnd - Pos)); // With its opening quote or bracket
+            return kEnd + 1ull;
+        }
+
+    private:
+        std::mutex m_Mutex = {};
+        std::deque<File> m_Files = {}; // By ID (a deque, so that growing it doesn't move the others)
+        Dictionary<uint32_t> m_FileIds = {};
+        Dictionary<std::unique_ptr<SearchPath>> m_SearchPaths = {}; // By their -I directories
+        Dictionary<bool> m_Exists = {};
+        size_t m_ReadCount = 0;
+    };
+
+
+    static uint64_t HashCommand(const Command& Cmd) noexcept
+    {
+        Utils::Fnv1a hash = {};
+        hash.Add(Cmd.Name);
+        Cmd.ForEachArg([&hash](const std::string& arg) { hash.Add(arg); });
+        return hash.Value;
+    }
+
+
+    enum class JobState : uint8_t
+    {
+        Clean = 0, // Its output is up to date, it doesn't run
+        Dirty,     // Has to run
+        Skipped,   // Had to run, but depends on a failed job
+        Done,      // Ran in this build (only kept track of for jobs that start before the graph is complete)
+        Failed,    // Same, but failed
+    };
+
+
+    // Jobs as parallel arrays, indexed by job (structure of arrays), so that the passes over the
+    // graph only touch the columns they use
+    struct JobTable
+    {
+        List<const Command*> Cmd = {};
+        List<CommandKind> Kind = {};
+        List<uint32_t> OutputId = {}; // Interned paths (see JobGraph::GetPath)
+        List<uint32_t> InputId = {};
+        List<JobState> State = {};
+        List<int32_t> Pool = {}; // Index into the graph's pools (-1 = not in a pool)
+        List<uint32_t> EstimateMs = {};
+        List<uint64_t> CriticalPathMs = {}; // EstimateMs + the longest path through the dependents
+        List<uint64_t> PeakRssKb = {}; // Predicted peak memory use
+        List<uint32_t> DependencyCount = {}; // Unfinished dependencies (a job is ready when this reaches 0)
+        List<uint32_t> Retries = {};
+
+        size_t GetCount() const noexcept
+        {
+            return Cmd.size();
+        }
+    };
+
+
+    // Edges in compressed sparse row form: the targets of node `i` are Targets[Offsets[i] .. Offsets[i + 1])
+    struct EdgeTable
+    {
+        List<uint32_t> Offsets = {};
+        List<uint32_t> Targets = {};
+
+        std::span<const uint32_t> Get(uint32_t Index) const noexcept
+        {
+            return { Targets.data() + Offsets[Index], Targets.data() + Offsets[Index + 1ull] };
+        }
+
+        // Counting sort of (From, To) pairs by `From`
+        void Build(size_t NodeCount, const List<std::pair<uint32_t, uint32_t>>& Edges, bool bReverse) noexcept
+        {
+            Offsets.assign(NodeCount + 1ull, 0u);
+            Targets.resize(Edges.size());
+            for (const auto& [kFrom, kTo] : Edges)
+            {
+                Offsets[(bReverse ? kTo : kFrom) + 1ull]++;
+            }
+            for (size_t kIndex = 0; kIndex < NodeCount; kIndex++)
+            {
+                Offsets[kIndex + 1ull] += Offsets[kIndex];
+            }
+
+            List<uint32_t> cursors(Offsets.begin(), Offsets.end() - 1);
+            for (const auto& [kFrom, kTo] : Edges)
+            {
+                Targets[cursors[bReverse ? kTo : kFrom]++] = bReverse ? kFrom : kTo;
+            }
+        }
+    };
+
+
+    class JobGraph
+    {
+    public:
+        static inline constexpr uint32_t NoPath = UINT32_MAX;
+        static inline constexpr int64_t MissingTime = INT64_MAX; // Newer than anything
+
+        uint32_t Add(const Command* pCmd, int32_t Pool = -1) noexcept
+        {
+            m_Jobs.Cmd.push_back(pCmd);
+            m_Jobs.Kind.push_back(pCmd->Kind);
+            m_Jobs.OutputId.push_back(InternPath(pCmd->Output));
+            m_Jobs.InputId.push_back(InternPath(pCmd->Input));
+            m_Jobs.State.push_back(JobState::Dirty);
+            m_Jobs.Pool.push_back(Pool);
+            return (uint32_t)(m_Jobs.GetCount() - 1ull);
+        }
+
+        // Adds a compile that was planned while the executor already runs, and decides right away whether it is
+        // dirty: a compile has no dependencies, so it doesn't have to wait for the rest of the graph. The times of
+        // its output and input (`MissingTime` if there is none) and its command's hash come from the planning
+        // thread. Streamed jobs come before all others, and `Estimate` and `MarkDirty` leave them as they are.
+        uint32_t AddStreamed(const Command* pCmd, int32_t Pool, const BuildDatabase& Db, int64_t OutputTime, int64_t InputTime, uint64_t CommandHash) noexcept
+        {
+            CBUILD_ASSERT(m_Jobs.GetCount() == m_StreamedCount, "Streamed jobs have to come first");
+            const uint32_t kIndex = Add(pCmd, Pool);
+            m_StreamedCount++;
+            m_StatCount += 2ull;
+
+            const NodeRecord* pRecord = Db.Find(pCmd->Output);
+            bool bDirty = OutputTime == MissingTime || InputTime > OutputTime || !pRecord || pRecord->CommandHash != CommandHash;
+            for (size_t kHeader = 0; !bDirty && kHeader < pRecord->Headers.size(); kHeader++)
+            {
+                bDirty = GetHeaderTime(Db, pRecord->Headers[kHeader]) > OutputTime;
+            }
+            m_Jobs.State[kIndex] = bDirty ? JobState::Dirty : JobState::Clean;
+
+            // Its critical path is only known once its dependents are, until then it is just its own
+            const uint32_t kEstimateMs = pRecord && pRecord->DurationMs ? pRecord->DurationMs : GuessDurationMs(kIndex);
+            m_Jobs.EstimateMs.push_back(bDirty ? kEstimateMs : 0u);
+            m_Jobs.CriticalPathMs.push_back(bDirty ? kEstimateMs : 0ull);
+            m_Jobs.PeakRssKb.push_back(pRecord && pRecord->PeakRssKb ? pRecord->PeakRssKb : GuessPeakRssKb(m_Jobs.Kind[kIndex]));
+            m_Jobs.DependencyCount.push_back(0u);
+            m_Jobs.Retries.push_back(0u);
+            return kIndex;
+        }
+
+        size_t GetStreamedCount() const noexcept
+        {
+            return m_StreamedCount;
+        }
+
+        int32_t AddPool(uint32_t Depth) noexcept
+        {
+            m_PoolDepths.push_back(std::max(1u, Depth));
+            return (int32_t)(m_PoolDepths.size() - 1ull);
+        }
+
+        // `To` cannot start before `From` has finished
+        void AddEdge(uint32_t From, uint32_t To) noexcept
+        {
+            m_Edges.push_back({ From, To });
+        }
+
+        // Builds the edge tables and sizes the per job columns, once every job and edge has been added
+        void Finalize() noexcept
+        {
+            const size_t kCount = m_Jobs.GetCount();
+            m_Dependents.Build(kCount, m_Edges, false);
+            m_Dependencies.Build(kCount, m_Edges, true);
+            m_Edges = {};
+
+            m_Jobs.EstimateMs.resize(kCount, 0u);
+            m_Jobs.CriticalPathMs.resize(kCount, 0ull);
+            m_Jobs.PeakRssKb.resize(kCount, 0ull);
+            m_Jobs.DependencyCount.resize(kCount, 0u);
+            m_Jobs.Retries.resize(kCount, 0u);
+            for (uint32_t kIndex = 0; kIndex < kCount; kIndex++)
+            {
+                m_Jobs.DependencyCount[kIndex] = (uint32_t)m_Dependencies.Get(kIndex).size();
+            }
+        }
+
+        // Uses the durations (and peak memory) recorded by previous builds, or a guess for nodes that were never built
+        void Estimate(const BuildDatabase& Db) noexcept
+        {
+            for (uint32_t kIndex = (uint32_t)m_StreamedCount; kIndex < m_Jobs.GetCount(); kIndex++)
+            {
+                const NodeRecord* pRecord = Db.Find(m_Jobs.Cmd[kIndex]->Output);
+                m_Jobs.EstimateMs[kIndex] = pRecord && pRecord->DurationMs ? pRecord->DurationMs : GuessDurationMs(kIndex);
+                m_Jobs.PeakRssKb[kIndex] = pRecord && pRecord->PeakRssKb ? pRecord->PeakRssKb : GuessPeakRssKb(m_Jobs.Kind[kIndex]);
+            }
+        }
+
+        // Topological order. Returns false if the graph has a cycle.
+        bool Sort() noexcept
+        {
+            const size_t kCount = m_Jobs.GetCount();
+            List<uint32_t> order = {};
+            order.reserve(kCount);
+
+            List<uint32_t> pending(m_Jobs.DependencyCount);
+            for (uint32_t kIndex = 0; kIndex < kCount; kIndex++)
+            {
+                if (pending[kIndex] == 0)
+                {
+                    order.push_back(kIndex);
+                }
+            }
+
+            // Topological order (Kahn)
+            for (size_t kCursor = 0; kCursor < order.size(); kCursor++)
+            {
+                for (const uint32_t kDependent : m_Dependents.Get(order[kCursor]))
+                {
+                    if (--pending[kDependent] == 0)
+                    {
+                        order.push_back(kDependent);
+                    }
+                }
+            }
+
+            if (order.size() != kCount)
+            {
+                return false;
+            }
+
+            m_Order = std::move(order);
+            return true;
+        }
+
+        // A job is dirty when its output is missing or was made by a different command, or when one of its
+        // inputs (or the headers its last build read) is newer than its output or is dirty itself. Clean jobs are
+        // left out of the build, and dependency counts only count dirty dependencies from here on. Returns the
+        // number of dirty jobs (streamed jobs that already ran included).
+        size_t MarkDirty(const BuildDatabase& Db) noexcept
+        {
+            static constexpr int64_t kMissing = MissingTime;
+            static constexpr size_t kGrain = 512;
+
+            const size_t kCount = m_Jobs.GetCount();
+
+            // The jobs' records, and through them the headers to look at (each once, however many jobs read it)
+            List<const NodeRecord*> records(kCount);
+            Tasks::ParallelFor(kCount, kGrain, [&](size_t Begin, size_t End)
+            {
+                for (size_t kIndex = std::max(Begin, m_StreamedCount); kIndex < End; kIndex++)
+                {
+                    records[kIndex] = Db.Find(m_Jobs.Cmd[kIndex]->Output);
+                }
+            });
+
+            List<const std::string*> paths(m_Paths); // Every path of the graph (outputs are also the inputs of their dependents)
+            List<uint32_t> headerPaths(Db.GetHeaderCount(), NoPath); // Header ID -> index in `paths`
+            for (const NodeRecord* pRecord : records)
+            {
+                for (size_t kHeader = 0; pRecord && kHeader < pRecord->Headers.size(); kHeader++)
+                {
+                    const uint32_t kId = pRecord->Headers[kHeader];
+                    if (headerPaths[kId] == NoPath)
+                    {
+                        headerPaths[kId] = (uint32_t)paths.size();
+                        paths.push_back(&Db.GetHeader(kId));
+                    }
+                }
+            }
+
+            List<int64_t> times(paths.size());
+            Tasks::ParallelFor(paths.size(), kGrain, [&](size_t Begin, size_t End)
+            {
+                for (size_t kPath = Begin; kPath < End; kPath++)
+                {
+                    if (!Platform::GetModifiedTime(paths[kPath]->c_str(), &times[kPath]))
+                    {
+                        times[kPath] = kMissing;
+                    }
+                }
+            });
+            m_StatCount += paths.size();
+
+            // What makes each job dirty on its own (hashing its command is most of the work)
+            Tasks::ParallelFor(kCount, kGrain, [&](size_t Begin, size_t End)
+            {
+                for (uint32_t kIndex = (uint32_t)std::max(Begin, m_StreamedCount); kIndex < End; kIndex++)
+                {
+                    const int64_t tOutput = times[m_Jobs.OutputId[kIndex]];
+                    const uint32_t kInput = m_Jobs.InputId[kIndex];
+                    const NodeRecord* pRecord = records[kIndex];
+                    bool bDirty = tOutput == kMissing || (kInput != NoPath && times[kInput] > tOutput) || !pRecord;
+
+                    for (const uint32_t kDependency : m_Dependencies.Get(kIndex))
+                    {
+                        bDirty = bDirty || times[m_Jobs.OutputId[kDependency]] > tOutput;
+                    }
+                    for (size_t kHeader = 0; !bDirty && kHeader < pRecord->Headers.size(); kHeader++)
+                    {
+                        bDirty = times[headerPaths[pRecord->Headers[kHeader]]] > tOutput;
+                    }
+
+                    bDirty = bDirty || pRecord->CommandHash != HashCommand(*m_Jobs.Cmd[kIndex]);
+                    m_Jobs.State[kIndex] = bDirty ? JobState::Dirty : JobState::Clean;
+                }
+            });
+
+            // Then what they get from their dependencies, in topological order
+            size_t kDirty = 0;
+            for (const uint32_t kIndex : m_Order)
+            {
+                // Dependencies that already ran make it dirty too, but there is nothing left to wait for
+                uint32_t kDirtyDependencies = 0;
+                bool bRan = false;
+                for (const uint32_t kDependency : m_Dependencies.Get(kIndex))
+                {
+                    kDirtyDependencies += m_Jobs.State[kDependency] == JobState::Dirty;
+                    bRan = bRan || m_Jobs.State[kDependency] == JobState::Done || m_Jobs.State[kDependency] == JobState::Failed;
+                }
+
+                m_Jobs.DependencyCount[kIndex] = kDirtyDependencies;
+                if (kDirtyDependencies || bRan)
+                {
+                    m_Jobs.State[kIndex] = JobState::Dirty;
+                }
+
+                if (m_Jobs.State[kIndex] != JobState::Clean)
+                {
+                    kDirty++;
+                }
+                else
+                {
+                    m_Jobs.EstimateMs[kIndex] = 0; // Off the critical path
+                }
+            }
+
+            return kDirty;
+        }
+
+        // Stats issued to check the jobs (by `AddStreamed` and `MarkDirty`)
+        size_t GetStatCount() const noexcept
+        {
+            return m_StatCount;
+        }
+
+        void ComputeCriticalPaths() noexcept
+        {
+            // Dependents always come after their dependencies, so walk backwards
+            for (auto it = m_Order.rbegin(); it != m_Order.rend(); ++it)
+            {
+                uint64_t longestMs = 0;
+                for (const uint32_t kDependent : m_Dependents.Get(*it))
+                {
+                    longestMs = std::max(longestMs, m_Jobs.CriticalPathMs[kDependent]);
+                }
+                m_Jobs.CriticalPathMs[*it] = m_Jobs.EstimateMs[*it] + longestMs;
+            }
+        }
+
+        JobTable& GetJobs() noexcept
+        {
+            return m_Jobs;
+        }
+
+        std::span<const uint32_t> GetDependents(uint32_t Index) const noexcept
+        {
+            return m_Dependents.Get(Index);
+        }
+
+        std::span<const uint32_t> GetDependencies(uint32_t Index) const noexcept
+        {
+            return m_Dependencies.Get(Index);
+        }
+
+        const std::string& GetPath(uint32_t Id) const noexcept
+        {
+            return *m_Paths[Id];
+        }
+
+        const List<uint32_t>& GetPoolDepths() const noexcept
+        {
+            return m_PoolDepths;
+        }
+
+    private:
+        // Open addressing (linear probing, at most half full). A slot holds (32-bit hash << 32 | path ID), so that
+        // probing rarely leaves the slot array: with millions of paths, a node based map is mostly cache misses.
+        uint32_t InternPath(const std::string& Path) noexcept
+        {
+            static constexpr uint64_t kEmpty = UINT64_MAX;
+
+            if (Path.empty())
+            {
+                return NoPath;
+            }
+
+            if ((m_Paths.size() + 1ull) * 2ull > m_PathSlots.size())
+            {
+                List<uint64_t> slots(std::max<size_t>(1024ull, m_PathSlots.size() * 2ull), kEmpty);
+                const size_t kMask = slots.size() - 1ull;
+                for (const uint64_t kEntry : m_PathSlots)
+                {
+                    if (kEntry != kEmpty)
+                    {
+                        size_t kSlot = (kEntry >> 32) & kMask;
+                        while (slots[kSlot] != kEmpty)
+                        {
+                            kSlot = (kSlot + 1ull) & kMask;
+                        }
+                        slots[kSlot] = kEntry;
+                    }
+                }
+                m_PathSlots = std::move(slots);
+            }
+
+            const uint64_t kHash = (uint32_t)std::hash<std::string_view>{}(Path);
+            const size_t kMask = m_PathSlots.size() - 1ull;
+            for (size_t kSlot = kHash & kMask;; kSlot = (kSlot + 1ull) & kMask)
+            {
+                const uint64_t kEntry = m_PathSlots[kSlot];
+                if (kEntry == kEmpty)
+                {
+                    m_PathSlots[kSlot] = (kHash << 32) | m_Paths.size();
+                    m_Paths.push_back(&Path);
+                    return (uint32_t)(m_Paths.size() - 1ull);
+                }
+                if ((kEntry >> 32) == kHash && *m_Paths[(uint32_t)kEntry] == Path)
+                {
+                    return (uint32_t)kEntry;
+                }
+            }
+        }
+
+        // Each header is only looked at once however many streamed jobs read it (the headers aren't built, so
+        // their times don't change during the build)
+        int64_t GetHeaderTime(const BuildDatabase& Db, uint32_t Id) noexcept
+        {
+            static constexpr int64_t kUnknown = INT64_MIN;
+
+            if (Id >= m_HeaderTimes.size())
+            {
+                m_HeaderTimes.resize(Db.GetHeaderCount(), kUnknown);
+            }
+            if (m_HeaderTimes[Id] == kUnknown)
+            {
+                m_StatCount++;
+                if (!Platform::GetModifiedTime(Db.GetHeader(Id).c_str(), &m_HeaderTimes[Id]))
+                {
+                    m_HeaderTimes[Id] = MissingTime;
+                }
+            }
+            return m_HeaderTimes[Id];
+        }
+
+        uint32_t GuessDurationMs(uint32_t Index) const noexcept
+        {
+            switch (m_Jobs.Kind[Index])
+            {
+                case CommandKind::Compile:
+                {
+                    // Roughly 5ms per KiB of source, on top of the compiler's startup cost
+                    std::error_code ec = {};
+                    const uintmax_t kSize = std::filesystem::file_size(m_Jobs.Cmd[Index]->Input, ec);
+                    return 50u + (ec ? 0u : (uint32_t)(kSize / 200u));
+                }
+                case CommandKind::Link:
+                case CommandKind::Archive:
+                    return 100u + 5u * (uint32_t)m_Dependencies.Get(Index).size();
+                default:
+                    return 100u;
+            }
+        }
+
+        static uint64_t GuessPeakRssKb(CommandKind Kind) noexcept
+        {
+            switch (Kind)
+            {
+                case CommandKind::Compile: return 256ull * 1024ull;
+                case CommandKind::Link:    return 512ull * 1024ull;
+                default:                   return 64ull * 1024ull;
+            }
+        }
+
+    private:
+        JobTable m_Jobs = {};
+        EdgeTable m_Dependents = {}; // Forward
+        EdgeTable m_Dependencies = {}; // Reverse
+        List<std::pair<uint32_t, uint32_t>> m_Edges = {}; // Until `Finalize`
+        List<uint32_t> m_Order = {}; // Topological
+        List<uint32_t> m_PoolDepths = {};
+        List<uint64_t> m_PathSlots = {};
+        List<const std::string*> m_Paths = {}; // By ID, into the commands (which outlive the graph)
+        List<int64_t> m_HeaderTimes = {}; // By header ID, for streamed jobs
+        size_t m_StreamedCount = 0;
+        size_t m_StatCount = 0;
+    };
+
+
+    // Gives the compiles that never succeeded (so have no depfile yet) the headers the scanner finds, so that the
+    // database knows what they read from the start. Returns how many sources were scanned.
+    static size_t ScanUnbuiltSources(JobGraph& Graph, BuildDatabase& Db, size_t* pReadCount = nullptr) noexcept
+    {
+        const JobTable& jobs = Graph.GetJobs();
+        List<uint32_t> unbuilt = {};
+        for (uint32_t kIndex = 0; kIndex < jobs.GetCount(); kIndex++)
+        {
+            if (jobs.Kind[kIndex] == CommandKind::Compile && !jobs.Cmd[kIndex]->Input.empty())
+            {
+                const NodeRecord* pRecord = Db.Find(jobs.Cmd[kIndex]->Output);
+                if (!pRecord || !pRecord->CommandHash)
+                {
+                    unbuilt.push_back(kIndex);
+                }
+            }
+        }
+        if (unbuilt.empty())
+        {
+            return 0;
+        }
+
+        IncludeScanner scanner{ Db };
+        List<List<std::string_view>> headers(unbuilt.size());
+        Tasks::ParallelFor(unbuilt.size(), 16ull, [&](size_t Begin, size_t End)
+        {
+            for (size_t kIndex = Begin; kIndex < End; kIndex++)
+            {
+                headers[kIndex] = scanner.Scan(*jobs.Cmd[unbuilt[kIndex]]);
+            }
+        });
+
+        for (size_t kIndex = 0; kIndex < unbuilt.size(); kIndex++)
+        {
+            Db.SetHeaders(jobs.Cmd[unbuilt[kIndex]]->Output, headers[kIndex]);
+        }
+        scanner.Store(Db);
+        if (pReadCount)
+        {
+            *pReadCount = scanner.GetReadCount();
+        }
+        return unbuilt.size();
+    }
+
+
+    // Ready jobs, the most critical first (ties go to the job that was planned first). Keys are kept in the
+    // heap beside the indices, so that sifting doesn't have to look them up in the job table.
+    class ReadyQueue
+    {
+    public:
+        explicit ReadyQueue(const List<uint64_t>& CriticalPathMs) noexcept
+            : m_CriticalPathMs{ &CriticalPathMs }
+        { }
+
+        void Push(uint32_t Index) noexcept
+        {
+            m_Heap.push_back({ (*m_CriticalPathMs)[Index], Index });
+            std::push_heap(m_Heap.begin(), m_Heap.end());
+        }
+
+        void Pop() noexcept
+        {
+            std::pop_heap(m_Heap.begin(), m_Heap.end());
+            m_Heap.pop_back();
+        }
+
+        uint32_t Top() const noexcept { return m_Heap.front().Index; }
+        bool IsEmpty() const noexcept { return m_Heap.empty(); }
+        size_t GetCount() const noexcept { return m_Heap.size(); }
+
+    private:
+        struct Entry
+        {
+            uint64_t CriticalPathMs = 0;
+            uint32_t Index = 0;
+
+            bool operator<(const Entry& Other) const noexcept
+            {
+                return CriticalPathMs != Other.CriticalPathMs ? CriticalPathMs < Other.CriticalPathMs : Index > Other.Index;
+            }
+        };
+
+        const List<uint64_t>* m_CriticalPathMs = nullptr;
+        List<Entry> m_Heap = {};
+    };
+
+
+    struct ProcessResult
+    {
+        int32_t ExitCode = 0;
+        uint64_t PeakRssKb = 0;
+        bool Killed = false; // By SIGKILL, which is how the OOM killer ends a process
+    };
+
+
+    class Process
+    {
+    public:
+#if defined(CBUILD_LINUX)
+        // Starts the command with its stdout and stderr going to `OutputFd` (-1 = inherited), its arguments
+        // read from `ResponseFile` if one is given, in `WorkingDir` if one is given. Returns -1 on failure.
+        static pid_t Spawn(const Command& Cmd, int OutputFd, const std::string& ResponseFile = {}, const std::string& WorkingDir = {}) noexcept
+        {
+            // The arguments are flattened into one buffer (NUL separated) only now, `argv` points into it
+            std::string buffer = {};
+            List<size_t> offsets = {};
+            const auto Append = [&buffer, &offsets](std::string_view arg)
+            {
+                offsets.push_back(buffer.size());
+                buffer.append(arg);
+                buffer.push_back('\0');
+            };
+
+            Append(Cmd.Name);
+            if (!ResponseFile.empty())
+            {
+                Append(std::format("@{}", ResponseFile));
+            }
+            else
+            {
+                offsets.reserve(Cmd.GetArgCount() + 1ull);
+                Cmd.ForEachArg(Append);
+            }
+
+            List<char*> argv = {};
+            argv.reserve(offsets.size() + 1ull);
+            for (const size_t kOffset : offsets)
+            {
+                argv.push_back(buffer.data() + kOffset);
+            }
+            argv.push_back(nullptr);
+
+            return Spawn(argv.data(), -1, OutputFd, OutputFd, 0, WorkingDir);
+        }
+
+        // Starts `Compiler` with its output piped into `Assembler` (like `gcc -pipe` does), both in the assembler's process
+        // group and with their diagnostics going to `OutputFd`. Returns the assembler (-1 on failure), `CompilerPid` is
+        // the compiler.
+        static pid_t SpawnPipeline(const List<std::string>& Compiler, const List<std::string>& Assembler, int OutputFd, pid_t& CompilerPid) noexcept
+        {
+            const auto MakeArgv = [](const List<std::string>& Args) -> List<char*>
+            {
+                List<char*> argv = {};
+                argv.reserve(Args.size() + 1ull);
+                for (const std::string& arg : Args)
+                {
+                    argv.push_back(const_cast<char*>(arg.c_str()));
+                }
+                argv.push_back(nullptr);
+                return argv;
+            };
+
+            int fds[2] = { -1, -1 };
+            if (pipe2(fds, O_CLOEXEC) != 0)
+            {
+                return -1;
+            }
+            const pid_t kAssemblerPid = Spawn(MakeArgv(Assembler).data(), fds[0], OutputFd, OutputFd, 0, {});
+            CompilerPid = kAssemblerPid > 0 ? Spawn(MakeArgv(Compiler).data(), -1, fds[1], OutputFd, kAssemblerPid, {}) : -1;
+            close(fds[0]);
+            close(fds[1]);
+
+            // Without a compiler the assembler would make an empty object of the end of its input
+            if (kAssemblerPid > 0 && CompilerPid <= 0)
+            {
+                kill(kAssemblerPid, SIGKILL);
+                (void)Wait(kAssemblerPid);
+                return -1;
+            }
+            return kAssemblerPid;
+        }
+
+        // Runs the command to completion, with its stdout and stderr read into `Output`
+        static ProcessResult Capture(const Command& Cmd, std::string& Output) noexcept
+        {
+            int fds[2] = { -1, -1 };
+            if (pipe2(fds, O_CLOEXEC) != 0)
+            {
+                return { .ExitCode = BuildResult::CommandProcessFailed };
+            }
+            const pid_t pid = Spawn(Cmd, fds[1]);
+            close(fds[1]);
+
+            char buffer[16 * 1024];
+            ssize_t kRead = 0;
+            while ((kRead = read(fds[0], buffer, sizeof(buffer))) > 0 || (kRead < 0 && errno == EINTR))
+            {
+                Output.append(buffer, (size_t)std::max<ssize_t>(kRead, 0));
+            }
+            close(fds[0]);
+            return pid > 0 ? Wait(pid) : ProcessResult{ .ExitCode = BuildResult::CommandProcessFailed };
+        }
+
+        // Starts `ppArgv` with the given stdin, stdout and stderr (-1 = inherited), in process group `Group` (0 = its own)
+        static pid_t Spawn(char* const* ppArgv, int InputFd, int OutputFd, int ErrorFd, pid_t Group, const std::string& WorkingDir) noexcept
+        {
+            posix_spawn_file_actions_t actions = {};
+            posix_spawn_file_actions_init(&actions);
+            if (InputFd >= 0)
+            {
+                posix_spawn_file_actions_adddup2(&actions, InputFd, STDIN_FILENO);
+            }
+            if (OutputFd >= 0)
+            {
+                posix_spawn_file_actions_adddup2(&actions, OutputFd, STDOUT_FILENO);
+            }
+            if (ErrorFd >= 0)
+            {
+                posix_spawn_file_actions_adddup2(&actions, ErrorFd, STDERR_FILENO);
+            }
+            if (!WorkingDir.empty())
+            {
+                posix_spawn_file_actions_addchdir_np(&actions, WorkingDir.c_str());
+            }
+
+            // The signals we take through a signalfd are blocked in our process, but not in the child
+            posix_spawnattr_t attr = {};
+            posix_spawnattr_init(&attr);
+            sigset_t signals = {};
+            sigemptyset(&signals);
+            posix_spawnattr_setsigmask(&attr, &signals);
+            signals = Platform::GetInterruptSignals();
+            posix_spawnattr_setsigdefault(&attr, &signals);
+            // In a process group of its own, so that cancelling it also reaches whatever it spawned
+            posix_spawnattr_setpgroup(&attr, Group);
+            posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+
+            pid_t pid = 0;
+            const int iError = posix_spawnp(&pid, ppArgv[0], &actions, &attr, ppArgv, environ);
+            posix_spawn_file_actions_destroy(&actions);
+            posix_spawnattr_destroy(&attr);
+
+            return iError == 0 ? pid : -1;
+        }
+
+        static ProcessResult Wait(pid_t Pid) noexcept
+        {
+            int iStatus = 0;
+            struct rusage usage = {};
+            while (wait4(Pid, &iStatus, 0, &usage) < 0)
+            {
+                if (errno != EINTR)
+                {
+                    return { .ExitCode = BuildResult::CommandProcessFailed };
+                }
+            }
+
+            return {
+                .ExitCode = WIFEXITED(iStatus) ? WEXITSTATUS(iStatus) : BuildResult::CommandProcessFailed,
+                .PeakRssKb = (uint64_t)usage.ru_maxrss,
+                .Killed = WIFSIGNALED(iStatus) && WTERMSIG(iStatus) == SIGKILL,
+            };
+        }
+#endif // CBUILD_LINUX
+
+        // Runs the command to completion
+        static ProcessResult Run(const Command& Cmd, const std::string& ResponseFile = {}, const std::string& WorkingDir = {}) noexcept
+        {
+#if defined(CBUILD_LINUX)
+            const pid_t pid = Spawn(Cmd, -1, ResponseFile, WorkingDir);
+            return pid > 0 ? Wait(pid) : ProcessResult{ .ExitCode = BuildResult::CommandProcessFailed };
+#else
+            std::string cmdline = ResponseFile.empty() ? ToString(Cmd) : std::format("{} @{}", Cmd.Name, ResponseFile);
+            if (!WorkingDir.empty())
+            {
+                cmdline = std::format("cd /d \"{}\" && {}", WorkingDir, cmdline);
+            }
+            return { .ExitCode = system(cmdline.c_str()) };
+#endif // CBUILD_LINUX
+        }
+
+        // Arguments in GCC's (libiberty) response file syntax: whitespace separated, backslash escaped
+        static std::string ToResponseFile(const Command& Cmd) noexcept
+        {
+            std::string text = {};
+            Cmd.ForEachArg([&text](const std::string& arg)
+            {
+                for (const char c : arg)
+                {
+                    if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\\' || c == '\'' || c == '"')
+                    {
+                        text += '\\';
+                    }
+                    text += c;
+                }
+                text += '\n';
+            });
+            return text;
+        }
+
+        static std::string ToString(const Command& Cmd) noexcept
+        {
+            std::string text = Cmd.Name;
+            Cmd.ForEachArg([&text](const std::string& arg)
+            {
+                text += ' ';
+                text += arg;
+            });
+            return text;
+        }
+    };
+
+
+#if defined(CBUILD_LINUX)
+    // Runs compiles without GCC's driver: what it would run for a compile (cc1/cc1plus, piped into `as` with -pipe)
+    // is asked of it (`-###`) once per distinct compiler, flags, source extension and object directory. The answer,
+    // made with placeholder paths, is only used once it is the driver's own answer for the first real compile it is
+    // filled in for. Compiles it has no answer for (other drivers, or plans that don't fit) are left to the driver.
+    class DriverBypass
+    {
+    public:
+        // The compiler and assembler that run the compile, piped together. False if the driver should run it.
+        bool Resolve(const Command& Cmd, List<std::string>& Compiler, List<std::string>& Assembler) noexcept
+        {
+            namespace stdfs = std::filesystem;
+
+            // Only compiles as the builders make them (see GenerateBuildCommandsAndOutputFiles)
+            if (Cmd.Kind != CommandKind::Compile || !Cmd.Prefix || Cmd.TempOutput.empty() || Cmd.Depfile.empty()
+                || Cmd.Args != List<std::string>{ "-c", Cmd.Input, "-o", Cmd.TempOutput, "-MF", Cmd.Depfile })
+            {
+                return false;
+            }
+
+            const Paths paths = {
+                .Input = Cmd.Input,
+                .Output = Cmd.TempOutput,
+                .Depfile = Cmd.Depfile,
+            };
+            const Paths placeholders = {
+                .Input = "cbuild-in/cbuild-src" + stdfs::path{ Cmd.Input }.extension().string(),
+                .Output = "cbuild-out/cbuild-obj" + stdfs::path{ Cmd.TempOutput }.extension().string(),
+                .Depfile = "cbuild-dep/cbuild-dep" + stdfs::path{ Cmd.Depfile }.extension().string(),
+            };
+
+            std::string key = Cmd.Name;
+            for (const std::string& arg : *Cmd.Prefix)
+            {
+                key.append(1, '\0').append(arg);
+            }
+            key.append(1, '\0').append(placeholders.Input).append(1, '\0').append(placeholders.Output).append(1, '\0').append(placeholders.Depfile);
+            key.append(1, '\0').append(stdfs::path{ Cmd.TempOutput }.parent_path().string());
+
+            Plan& plan = m_Plans[key];
+            if (plan.State == PlanState::Unknown)
+            {
+                Plan driven = {};
+                plan.State = Ask(Cmd, placeholders, plan) && Ask(Cmd, paths, driven) && Fill(plan, placeholders, paths) == driven.Steps
+                    ? PlanState::Known
+                    : PlanState::Driver;
+            }
+            if (plan.State != PlanState::Known)
+            {
+                return false;
+            }
+
+            List<List<std::string>> steps = Fill(plan, placeholders, paths);
+            Compiler = std::move(steps[0]);
+            Assembler = std::move(steps[1]);
+            return true;
+        }
+
+    private:
+        enum class PlanState : uint8_t
+        {
+            Unknown = 0,
+            Known,
+            Driver, // Left to the driver
+        };
+
+        struct Plan
+        {
+            PlanState State = PlanState::Unknown;
+            List<List<std::string>> Steps = {}; // The compiler, then the assembler it is piped into
+        };
+
+        struct Paths
+        {
+            std::string Input = {};
+            std::string Output = {};
+            std::string Depfile = {};
+        };
+
+        // What the driver would run for the compile of `Files`. False unless it is one step piped into another.
+        static bool Ask(const Command& Cmd, const Paths& Files, Plan& Out) noexcept
+        {
+            const Command query = { .Name = Cmd.Name, .Prefix = Cmd.Prefix, .Args = { "-###", "-pipe", "-c", Files.Input, "-o", Files.Output, "-MF", Files.Depfile } };
+            std::string text = {};
+            if (Process::Capture(query, text).ExitCode != 0)
+            {
+                return false;
+            }
+
+            // Each step is a line that starts with a blank. Arguments are quoted ("...", with `\` escapes) unless they
+            // are plain, and a step that pipes into the next one ends with a bare `|`.
+            bool bPiped = false;
+            for (size_t kPos = 0; kPos < text.size();)
+            {
+                size_t kEnd = text.find('\n', kPos);
+                kEnd = kEnd == std::string::npos ? text.size() : kEnd;
+                const std::string_view line{ text.data() + kPos, kEnd - kPos };
+                kPos = kEnd + 1ull;
+                if (line.empty() || line[0] != ' ')
+                {
+                    continue;
+                }
+                if (!Out.Steps.empty() && !bPiped)
+                {
+                    return false;
+                }
+
+                List<std::string>& step = Out.Steps.emplace_back();
+                bPiped = false;
+                for (size_t kIndex = 0; kIndex < line.size();)
+                {
+                    if (line[kIndex] == ' ')
+                    {
+                        kIndex++;
+                        continue;
+                    }
+                    std::string arg = {};
+                    if (line[kIndex] == '"')
+                    {
+                        for (kIndex++; kIndex < line.size() && line[kIndex] != '"'; kIndex++)
+                        {
+                            if (line[kIndex] == '\\' && kIndex + 1ull < line.size())
+                            {
+                                kIndex++;
+                            }
+                            arg.push_back(line[kIndex]);
+                        }
+                        kIndex++;
+                    }
+                    else
+                    {
+                        for (; kIndex < line.size() && line[kIndex] != ' '; kIndex++)
+                        {
+                            arg.push_back(line[kIndex]);
+                        }
+                        if (arg == "|")
+                        {
+                            bPiped = true;
+                            continue;
+                        }
+                    }
+                    step.push_back(std::move(arg));
+                }
+            }
+            return Out.Steps.size() == 2ull && !bPiped && !Out.Steps[0].empty() && !Out.Steps[1].empty();
+        }
+
+        // The plan's steps, with the paths (and what the driver makes of them: directories, stems) of `From` replaced
+        // by those of `To`
+        static List<List<std::string>> Fill(const Plan& P, const Paths& From, const Paths& To) noexcept
+        {
+            namespace stdfs = std::filesystem;
+
+            const auto Dir = [](const std::string& Filepath) -> std::string
+            {
+                return (stdfs::path{ Filepath }.parent_path() / "").string();
+            };
+            const auto Stem = [](const std::string& Filepath) -> std::string
+            {
+                return stdfs::path{ Filepath }.stem().string();
+            };
+            const std::pair<std::string, std::string> replacements[] =
+            {
+                { From.Input, To.Input },
+                { From.Output, To.Output },
+                { From.Depfile, To.Depfile },
+                { Dir(From.Input), Dir(To.Input) },
+                { Dir(From.Output), Dir(To.Output) },
+                { Dir(From.Depfile), Dir(To.Depfile) },
+                { Stem(From.Input), Stem(To.Input) },
+                { Stem(From.Output), Stem(To.Output) },
+                { Stem(From.Depfile), Stem(To.Depfile) },
+            };
+
+            List<List<std::string>> steps = P.Steps;
+            for (List<std::string>& step : steps)
+            {
+                for (std::string& arg : step)
+                {
+                    // In one pass, so that what is put in is not replaced again
+                    std::string filled = {};
+                    for (size_t kPos = 0; kPos < arg.size();)
+                    {
+                        const auto it = std::find_if(std::begin(replacements), std::end(replacements), [&](const auto& R)
+                        {
+                            return std::string_view{ arg }.substr(kPos).starts_with(R.first);
+                        });
+                        if (it != std::end(replacements))
+                        {
+                            filled += it->second;
+                            kPos += it->first.size();
+                        }
+                        else
+                        {
+                            filled += arg[kPos++];
+                        }
+                    }
+                    arg = std::move(filled);
+                }
+            }
+            return steps;
+        }
+
+    private:
+        Map<std::string, Plan> m_Plans = {};
+    };
+#endif // CBUILD_LINUX
+
+
+    // GNU make jobserver: a pipe (or fifo) holding one token per job slot beyond the one every process
+    // implicitly owns. We join the jobserver advertised in MAKEFLAGS, or else create one for the
+    // processes we spawn (sub-builds, `make`, GCC's -flto=jobserver), so the whole tree shares one limit.
+    class Jobserver
+    {
+    public:
+        inline Jobserver() noexcept = default;
+        Jobserver(const Jobserver&) = delete;
+        Jobserver& operator=(const Jobserver&) = delete;
+
+        inline ~Jobserver() noexcept
+        {
+#if defined(CBUILD_LINUX)
+            while (!m_Tokens.empty())
+            {
+                Release();
+            }
+            if (m_ReadFd >= 0)
+            {
+                close(m_ReadFd);
+            }
+            if (m_WriteFd >= 0 && m_OwnsWriteFd)
+            {
+                close(m_WriteFd);
+            }
+            if (!m_Client)
+            {
+                for (const int iFd : m_ServerFds)
+                {
+                    close(iFd);
+                }
+            }
+#endif // CBUILD_LINUX
+        }
+
+        // Joins the jobserver from MAKEFLAGS if there is one; otherwise creates one with `Jobs - 1` tokens
+        // and advertises it to our children. Returns false if there is no jobserver to use.
+        bool Setup(uint32_t Jobs) noexcept
+        {
+#if defined(CBUILD_LINUX)
+            const char* lpMakeflags = getenv("MAKEFLAGS");
+            const std::string_view makeflags = lpMakeflags ? lpMakeflags : "";
+            for (const std::string_view option : { "--jobserver-auth=", "--jobserver-fds=" })
+            {
+                const size_t kPos = makeflags.rfind(option);
+                if (kPos == std::string_view::npos)
+                {
+                    continue;
+                }
+
+                std::string_view auth = makeflags.substr(kPos + option.size());
+                auth = auth.substr(0, auth.find(' '));
+                m_Client = Join(std::string{ auth });
+                if (m_Client)
+                {
+                    return true;
+                }
+            }
+
+            return Jobs > 1 && Serve(Jobs - 1, makeflags);
+#else
+            (void)Jobs;
+            return false;
+#endif // CBUILD_LINUX
+        }
+
+        bool IsClient() const noexcept
+        {
+            return m_Client;
+        }
+
+        // Readable when a token may be available (-1 = no jobserver)
+        int GetReadFd() const noexcept
+        {
+            return m_ReadFd;
+        }
+
+        size_t GetTokenCount() const noexcept
+        {
+            return m_Tokens.size();
+        }
+
+        // Takes a token, if one is available right now
+        bool TryAcquire() noexcept
+        {
+#if defined(CBUILD_LINUX)
+            char token = 0;
+            for (;;)
+            {
+                const ssize_t kRead = read(m_ReadFd, &token, 1);
+                if (kRead == 1)
+                {
+                    m_Tokens.push_back(token);
+                    return true;
+                }
+                if (kRead < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+#else
+            return false;
+#endif // CBUILD_LINUX
+        }
+
+        // Gives back a token (the same byte that was read, as make expects)
+        void Release() noexcept
+        {
+#if defined(CBUILD_LINUX)
+            CBUILD_ASSERT(!m_Tokens.empty(), "No jobserver token to release");
+            const char token = m_Tokens.back();
+            m_Tokens.pop_back();
+            while (write(m_WriteFd, &token, 1) < 0 && errno == EINTR)
+            { }
+#endif // CBUILD_LINUX
+        }
+
+    private:
+#if defined(CBUILD_LINUX)
+        // "fifo:<path>" (make 4.4+) or "<read-fd>,<write-fd>"
+        bool Join(const std::string& Auth) noexcept
+        {
+            if (Auth.starts_with("fifo:"))
+            {
+                m_ReadFd = open(Auth.c_str() + 5, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+                m_WriteFd = m_ReadFd;
+                return m_ReadFd >= 0;
+            }
+
+            int iRead = -1, iWrite = -1;
+            if (sscanf(Auth.c_str(), "%d,%d", &iRead, &iWrite) != 2 || iRead < 0 || iWrite < 0)
+            {
+                return false;
+            }
+            // make only passes the pipe to recipes marked as recursive (`+`)
+            if (fcntl(iRead, F_GETFD) < 0 || fcntl(iWrite, F_GETFD) < 0)
+            {
+                return false;
+            }
+
+            // A new open file description, so it can be non-blocking without affecting the other clients
+            m_ReadFd = open(std::format("/proc/self/fd/{}", iRead).c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+            m_WriteFd = iWrite;
+            m_OwnsWriteFd = false;
+            return m_ReadFd >= 0;
+        }
+
+        bool Serve(uint32_t Tokens, const std::string_view& Makeflags) noexcept
+        {
+            // Inherited by every child (no O_CLOEXEC); children block on it, so only our end is non-blocking
+            if (pipe(m_ServerFds) != 0)
+            {
+                return false;
+            }
+
+            m_ReadFd = open(std::format("/proc/self/fd/{}", m_ServerFds[0]).c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+            m_WriteFd = m_ServerFds[1];
+            m_OwnsWriteFd = false;
+            if (m_ReadFd < 0)
+            {
+                return false;
+            }
+
+            const std::string tokens(Tokens, '+');
+            if (write(m_WriteFd, tokens.data(), tokens.size()) != (ssize_t)tokens.size())
+            {
+                return false;
+            }
+
+            // Ahead of the variables make passes on (after `--`), which would take the options for targets
+            const size_t kVariables = Makeflags.starts_with("-- ") ? 0ull : std::min(Makeflags.find(" -- "), Makeflags.size());
+            const std::string makeflags = std::format("{} -j{} --jobserver-auth={},{} {}", Makeflags.substr(0ull, kVariables), Tokens + 1u,
+                m_ServerFds[0], m_ServerFds[1], Makeflags.substr(kVariables));
+            setenv("MAKEFLAGS", makeflags.c_str(), 1);
+            return true;
+        }
+#endif // CBUILD_LINUX
+
+    private:
+        int m_ReadFd = -1;
+        int m_WriteFd = -1;
+        int m_ServerFds[2] = { -1, -1 };
+        bool m_OwnsWriteFd = true;
+        bool m_Client = false;
+        List<char> m_Tokens = {};
+    };
+
+
+    struct Completion
+    {
+        uint32_t Index = 0;
+        ProcessResult Result = {};
+        uint32_t DurationMs = 0;
+    };
+
+
+    // The executor's event loop. On Linux it is single-threaded: one epoll set waits on a pidfd per
+    // running process, their output pipes (read into a buffer per job), a signalfd for Ctrl-C and an
+    // eventfd for `Notify`. Elsewhere, a thread per running process waits on it and posts its completion.
+    class JobEvents
+    {
+    public:
+        static inline constexpr size_t MaxOutputBytes = 1ull << 20; // Per job, the rest is dropped
+
+        inline JobEvents(size_t JobCount) noexcept
+            : m_Slots(JobCount)
+        {
+#if defined(CBUILD_LINUX)
+            m_Epoll = epoll_create1(EPOLL_CLOEXEC);
+            CBUILD_ASSERT(m_Epoll >= 0, "Failed to create the job event loop");
+
+            // Delivered through the signalfd instead (SIGCHLD only matters without pidfds)
+            const sigset_t signals = Platform::GetInterruptSignals();
+            pthread_sigmask(SIG_BLOCK, &signals, &m_OldSignalMask);
+            m_Signal = signalfd(-1, &signals, SFD_CLOEXEC | SFD_NONBLOCK);
+            CBUILD_ASSERT(m_Signal >= 0, "Failed to create the job event loop");
+
+            epoll_event ev = { .events = EPOLLIN, .data = { .u64 = MakeKey(KeyKind::Signal, 0) } };
+            epoll_ctl(m_Epoll, EPOLL_CTL_ADD, m_Signal, &ev);
+
+            m_Notify = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            CBUILD_ASSERT(m_Notify >= 0, "Failed to create the job event loop");
+            ev = { .events = EPOLLIN, .data = { .u64 = MakeKey(KeyKind::Notify, 0) } };
+            epoll_ctl(m_Epoll, EPOLL_CTL_ADD, m_Notify, &ev);
+#endif // CBUILD_LINUX
+        }
+
+        inline ~JobEvents() noexcept
+        {
+#if defined(CBUILD_LINUX)
+            for (Slot& slot : m_Slots)
+            {
+                if (slot.OutputFd >= 0)
+                {
+                    close(slot.OutputFd);
+                }
+                if (slot.PidFd >= 0)
+                {
+                    close(slot.PidFd);
+                }
+            }
+            close(m_Notify);
+            close(m_Signal);
+            close(m_Epoll);
+            pthread_sigmask(SIG_SETMASK, &m_OldSignalMask, nullptr);
+#endif // CBUILD_LINUX
+        }
+
+        // For jobs added after the loop was made
+        void Grow(size_t JobCount) noexcept
+        {
+            if (m_Slots.size() < JobCount)
+            {
+                m_Slots.resize(JobCount);
+            }
+        }
+
+        // Returns the write end of a new output pipe for the job (-1 = not captured)
+        int OpenOutput(uint32_t Index) noexcept
+        {
+#if defined(CBUILD_LINUX)
+            int fds[2] = { -1, -1 };
+            if (pipe2(fds, O_CLOEXEC) != 0)
+            {
+                return -1;
+            }
+            fcntl(fds[0], F_SETFL, O_NONBLOCK); // Only our end, the compiler gets a normal (blocking) pipe
+
+            Slot& slot = m_Slots[Index];
+            slot.OutputFd = fds[0];
+            slot.Text.clear();
+            slot.DroppedBytes = 0;
+
+            epoll_event ev = { .events = EPOLLIN, .data = { .u64 = MakeKey(KeyKind::Output, Index) } };
+            epoll_ctl(m_Epoll, EPOLL_CTL_ADD, slot.OutputFd, &ev);
+            return fds[1];
+#else
+            (void)Index;
+            return -1;
+#endif // CBUILD_LINUX
+        }
+
+#if defined(CBUILD_LINUX)
+        // The job's process is reported as completed by Wait() once it has exited. `FeederPid` is a process that
+        // feeds it (through a pipe, in its process group), collected along with it.
+        void WatchProcess(uint32_t Index, pid_t Pid, std::chrono::steady_clock::time_point Start, pid_t FeederPid = -1) noexcept
+        {
+            Slot& slot = m_Slots[Index];
+            slot.Pid = Pid;
+            slot.FeederPid = FeederPid;
+            slot.Start = Start;
+#if defined(SYS_pidfd_open)
+            slot.PidFd = (int)syscall(SYS_pidfd_open, Pid, 0);
+#endif // SYS_pidfd_open
+            if (slot.PidFd >= 0)
+            {
+                epoll_event ev = { .events = EPOLLIN, .data = { .u64 = MakeKey(KeyKind::Process, Index) } };
+                epoll_ctl(m_Epoll, EPOLL_CTL_ADD, slot.PidFd, &ev);
+            }
+            // Without pidfds (Linux < 5.3), SIGCHLD tells us to check on it
+            Reap(Index);
+        }
+
+        // Asks every running process to stop
+        void KillAll(int Signal) noexcept
+        {
+            for (const Slot& slot : m_Slots)
+            {
+                if (slot.Pid > 0)
+                {
+                    kill(-slot.Pid, Signal);
+                }
+            }
+        }
+#endif // CBUILD_LINUX
+
+        // Makes the next Wait() also return once `Fd` is readable
+        void WatchOnce(int Fd) noexcept
+        {
+#if defined(CBUILD_LINUX)
+            epoll_event ev = { .events = EPOLLIN | EPOLLONESHOT, .data = { .u64 = MakeKey(KeyKind::Watch, 0) } };
+            if (epoll_ctl(m_Epoll, EPOLL_CTL_MOD, Fd, &ev) != 0)
+            {
+                epoll_ctl(m_Epoll, EPOLL_CTL_ADD, Fd, &ev);
+            }
+#else
+            (void)Fd;
+#endif // CBUILD_LINUX
+        }
+
+        // Thread-safe
+        void Post(const Completion& C) noexcept
+        {
+            {
+                std::lock_guard<std::mutex> lock{ m_Mutex };
+                m_Completions.push_back(C);
+            }
+#if !defined(CBUILD_LINUX)
+            m_Cv.notify_one();
+#endif // !CBUILD_LINUX
+        }
+
+        // Thread-safe. Makes the current (or next) Wait() return, even if nothing completed.
+        void Notify() noexcept
+        {
+#if defined(CBUILD_LINUX)
+            const uint64_t kOne = 1;
+            (void)!write(m_Notify, &kOne, sizeof(kOne));
+#else
+            {
+                std::lock_guard<std::mutex> lock{ m_Mutex };
+                m_Notified = true;
+            }
+            m_Cv.notify_one();
+#endif // CBUILD_LINUX
+        }
+
+        // Number of interrupting signals (Ctrl-C, SIGTERM, SIGHUP) received so far
+        uint32_t GetInterruptCount() const noexcept
+        {
+            return m_Interrupts;
+        }
+
+        // Waits until something completes, we are interrupted or notified, a watched fd is readable, or
+        // the timeout (-1 = none) runs out
+        List<Completion> Wait(int32_t TimeoutMs) noexcept
+        {
+            List<Completion> completions = {};
+#if defined(CBUILD_LINUX)
+            const uint32_t kInterrupts = m_Interrupts;
+            for (;;)
+            {
+                if (!m_Completions.empty() || m_Interrupts != kInterrupts)
+                {
+                    completions.swap(m_Completions);
+                    return completions;
+                }
+
+                epoll_event events[64] = {};
+                const int iCount = epoll_wait(m_Epoll, events, (int)std::size(events), TimeoutMs);
+                if (iCount == 0)
+                {
+                    return completions;
+                }
+
+                bool bWatched = false;
+                for (int iIndex = 0; iIndex < iCount; iIndex++)
+                {
+                    const uint64_t kKey = events[iIndex].data.u64;
+                    const uint32_t kIndex = (uint32_t)kKey;
+                    switch ((KeyKind)(kKey >> 32))
+                    {
+                        case KeyKind::Output:  ReadOutput(kIndex); break;
+                        case KeyKind::Process: Reap(kIndex); break;
+                        case KeyKind::Watch:   bWatched = true; break;
+                        case KeyKind::Signal:  ReadSignals(); break;
+                        case KeyKind::Notify:  bWatched |= ReadNotify(); break; // Not to lose a `Watch` earlier in the batch
+                    }
+                }
+
+                if (bWatched)
+                {
+                    completions.swap(m_Completions);
+                    return completions;
+                }
+            }
+#else
+            std::unique_lock<std::mutex> lock{ m_Mutex };
+            const auto HasCompletions = [this]() { return !m_Completions.empty() || m_Notified; };
+            if (TimeoutMs >= 0)
+            {
+                m_Cv.wait_for(lock, std::chrono::milliseconds(TimeoutMs), HasCompletions);
+            }
+            else
+            {
+                m_Cv.wait(lock, HasCompletions);
+            }
+            m_Notified = false;
+            completions.swap(m_Completions);
+            return completions;
+#endif // CBUILD_LINUX
+        }
+
+        // Everything the (finished) job wrote
+        std::string TakeOutput(uint32_t Index) noexcept
+        {
+            Slot& slot = m_Slots[Index];
+#if defined(CBUILD_LINUX)
+            if (slot.OutputFd >= 0)
+            {
+                ReadOutput(Index);
+                if (slot.OutputFd >= 0)
+                {
+                    // Still held open by something the job left running in the background
+                    close(slot.OutputFd);
+                    slot.OutputFd = -1;
+                }
+            }
+#endif // CBUILD_LINUX
+
+            std::string text = std::move(slot.Text);
+            if (slot.DroppedBytes)
+            {
+                text += std::format("\n[... {} more bytes of output dropped]\n", slot.DroppedBytes);
+            }
+            slot.Text = {};
+            slot.DroppedBytes = 0;
+            return text;
+        }
+
+    private:
+#if defined(CBUILD_LINUX)
+        enum class KeyKind : uint32_t
+        {
+            Output = 0,
+            Process,
+            Watch,
+            Signal,
+            Notify,
+        };
+
+        static uint64_t MakeKey(KeyKind Kind, uint32_t Index) noexcept
+        {
+            return ((uint64_t)Kind << 32) | Index;
+        }
+
+        void ReadOutput(uint32_t Index) noexcept
+        {
+            Slot& slot = m_Slots[Index];
+            char buffer[16 * 1024];
+            for (;;)
+            {
+                const ssize_t kRead = read(slot.OutputFd, buffer, sizeof(buffer));
+                if (kRead > 0)
+                {
+                    const size_t kKept = std::min((size_t)kRead, MaxOutputBytes - std::min(MaxOutputBytes, slot.Text.size()));
+                    slot.Text.append(buffer, kKept);
+                    slot.DroppedBytes += (size_t)kRead - kKept;
+                }
+                else if (kRead < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                else
+                {
+                    if (kRead == 0 || errno != EAGAIN)
+                    {
+                        close(slot.OutputFd); // Also takes it out of the epoll set
+                        slot.OutputFd = -1;
+                    }
+                    return;
+                }
+            }
+        }
+
+        // Collects the job's process if it has exited
+        void Reap(uint32_t Index) noexcept
+        {
+            using Clock = std::chrono::steady_clock;
+
+            Slot& slot = m_Slots[Index];
+            if (slot.Pid <= 0)
+            {
+                return;
+            }
+
+            int iStatus = 0;
+            struct rusage usage = {};
+            pid_t pid = 0;
+            while ((pid = wait4(slot.Pid, &iStatus, WNOHANG, &usage)) < 0 && errno == EINTR)
+            { }
+            if (pid == 0)
+            {
+                return; // Still running
+            }
+
+            ProcessResult result = pid < 0 ? ProcessResult{ .ExitCode = BuildResult::CommandProcessFailed } : ProcessResult{
+                .ExitCode = WIFEXITED(iStatus) ? WEXITSTATUS(iStatus) : BuildResult::CommandProcessFailed,
+                .PeakRssKb = (uint64_t)usage.ru_maxrss,
+                .Killed = WIFSIGNALED(iStatus) && WTERMSIG(iStatus) == SIGKILL,
+            };
+            if (slot.FeederPid > 0)
+            {
+                // Having read all it was fed, the job's process has outlived its feeder (so this doesn't block). If it
+                // failed, the feeder is of no use anymore. If it didn't, the feeder's failure is the job's: its consumer
+                // takes a truncated input just fine.
+                if (result.ExitCode != 0)
+                {
+                    kill(slot.FeederPid, SIGKILL);
+                }
+                const ProcessResult feeder = Process::Wait(slot.FeederPid);
+                if (result.ExitCode == 0)
+                {
+                    result.ExitCode = feeder.ExitCode;
+                    result.Killed = feeder.Killed;
+                }
+                result.PeakRssKb = std::max(result.PeakRssKb, feeder.PeakRssKb);
+                slot.FeederPid = -1;
+            }
+            const auto kElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - slot.Start);
+            m_Completions.push_back({ Index, result, (uint32_t)kElapsed.count() });
+
+            if (slot.PidFd >= 0)
+            {
+                close(slot.PidFd);
+                slot.PidFd = -1;
+            }
+            slot.Pid = -1;
+        }
+
+        bool ReadNotify() noexcept
+        {
+            uint64_t kCount = 0;
+            return read(m_Notify, &kCount, sizeof(kCount)) == (ssize_t)sizeof(kCount);
+        }
+
+        void ReadSignals() noexcept
+        {
+            signalfd_siginfo info = {};
+            while (read(m_Signal, &info, sizeof(info)) == (ssize_t)sizeof(info))
+            {
+                if (info.ssi_signo == SIGCHLD)
+                {
+                    for (uint32_t kIndex = 0; kIndex < m_Slots.size(); kIndex++)
+                    {
+                        if (m_Slots[kIndex].Pid > 0 && m_Slots[kIndex].PidFd < 0)
+                        {
+                            Reap(kIndex);
+                        }
+                    }
+                }
+                else
+                {
+                    m_Interrupts++;
+                }
+            }
+        }
+#endif // CBUILD_LINUX
+
+    private:
+        struct Slot
+        {
+            int OutputFd = -1;
+            std::string Text = {};
+            size_t DroppedBytes = 0;
+#if defined(CBUILD_LINUX)
+            pid_t Pid = -1;
+            pid_t FeederPid = -1;
+            int PidFd = -1;
+            std::chrono::steady_clock::time_point Start = {};
+#endif // CBUILD_LINUX
+        };
+
+        List<Slot> m_Slots = {};
+        std::mutex m_Mutex = {};
+        List<Completion> m_Completions = {};
+        uint32_t m_Interrupts = 0;
+#if defined(CBUILD_LINUX)
+        int m_Epoll = -1;
+        int m_Signal = -1;
+        int m_Notify = -1;
+        sigset_t m_OldSignalMask = {};
+#else
+        std::condition_variable m_Cv = {};
+        bool m_Notified = false;
+#endif // CBUILD_LINUX
+    };
+
+
+    // ninja-style progress: a single `[finished/total] description` line that is rewritten in place on
+    // terminals, with each job's output written in one piece once the job has finished
+    class StatusPrinter
+    {
+    public:
+        inline StatusPrinter(size_t Total, bool bVerbose) noexcept
+            : m_Total{ Total }, m_Verbose{ bVerbose }
+        {
+#if defined(CBUILD_LINUX)
+            const char* lpTerm = getenv("TERM");
+            m_SmartTerminal = isatty(STDOUT_FILENO) && lpTerm && strcmp(lpTerm, "dumb") != 0;
+#endif // CBUILD_LINUX
+        }
+
+        // The total grows while jobs are still being planned
+        void SetTotal(size_t Total) noexcept
+        {
+            m_Total = Total;
+        }
+
+        void JobStarted(const Command& Cmd, size_t Finished) noexcept
+        {
+            PrintStatus(Cmd, Finished);
+        }
+
+        void JobFinished(const Command& Cmd, size_t Finished, bool bFailed, const std::string& Output) noexcept
+        {
+            if (m_SmartTerminal)
+            {
+                PrintStatus(Cmd, Finished);
+            }
+
+            if (!bFailed && Output.empty())
+            {
+                return;
+            }
+
+            std::string text = {};
+            if (m_SmartTerminal && m_StatusShown)
+            {
+                text += '\n';
+                m_StatusShown = false;
+            }
+            if (bFailed)
+            {
+                text += std::format("FAILED: {}\n{}\n", Cmd.Output, Process::ToString(Cmd));
+            }
+            text += Output;
+            if (!text.empty() && text.back() != '\n')
+            {
+                text += '\n';
+            }
+            Write(text);
+        }
+
+        void Message(const std::string& Text) noexcept
+        {
+            Write(((m_SmartTerminal && m_StatusShown) ? "\n" : "") + Text + "\n");
+            m_StatusShown = false;
+        }
+
+        void Finish() noexcept
+        {
+            if (m_SmartTerminal && m_StatusShown)
+            {
+                Write("\n");
+                m_StatusShown = false;
+            }
+        }
+
+    private:
+        void PrintStatus(const Command& Cmd, size_t Finished) noexcept
+        {
+            std::string line = std::format("[{}/{}] {}", Finished, m_Total, Describe(Cmd));
+            if (m_SmartTerminal && !m_Verbose)
+            {
+#if defined(CBUILD_LINUX)
+                winsize size = {};
+                if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 4 && line.size() >= size.ws_col)
+                {
+                    line.resize(size.ws_col - 4u);
+                    line += "...";
+                }
+#endif // CBUILD_LINUX
+                Write("\r" + line + "\x1b[K");
+                m_StatusShown = true;
+            }
+            else
+            {
+                Write(line + "\n");
+            }
+        }
+
+        std::string Describe(const Command& Cmd) const noexcept
+        {
+            if (m_Verbose)
+            {
+                return Process::ToString(Cmd);
+            }
+
+            switch (Cmd.Kind)
+            {
+                case CommandKind::Compile: return (Cmd.Depfile == Cmd.Output ? "Checking " : "Compiling ") + Cmd.Input;
+                case CommandKind::Link:    return "Linking " + Cmd.Output;
+                case CommandKind::Archive: return "Archiving " + Cmd.Output;
+                default:                   return "Running " + Cmd.Name;
+            }
+        }
+
+        static void Write(const std::string& Text) noexcept
+        {
+            fwrite(Text.data(), 1, Text.size(), stdout);
+            fflush(stdout);
+        }
+
+    private:
+        size_t m_Total = 0;
+        bool m_Verbose = false;
+        bool m_SmartTerminal = false;
+        bool m_StatusShown = false; // The cursor is at the end of the status line
+    };
+
+
+    // Hands the compiles over from the threads that plan the projects to the executor, which adds (and starts)
+    // them while the rest is still being planned. The filesystem half of checking a compile is done here, on the
+    // planning thread; the executor only looks up its record.
+    class CompileFeed
+    {
+    public:
+        struct Item
+        {
+            Command Cmd = {};
+            int32_t Pool = -1;
+            uint32_t Group = 0; // The project it belongs to
+            int64_t OutputTime = JobGraph::MissingTime;
+            int64_t InputTime = INT64_MIN; // Without an input, never newer
+            uint64_t CommandHash = 0;
+        };
+
+        // Thread-safe
+        void Push(uint32_t Group, const Command& Cmd, int32_t Pool) noexcept
+        {
+            Item item = { .Cmd = Cmd, .Pool = Pool, .Group = Group, .CommandHash = HashCommand(Cmd) };
+            if (!Platform::GetModifiedTime(Cmd.Output.c_str(), &item.OutputTime))
+            {
+                item.OutputTime = JobGraph::MissingTime;
+            }
+            if (!Cmd.Input.empty() && !Platform::GetModifiedTime(Cmd.Input.c_str(), &item.InputTime))
+            {
+                item.InputTime = JobGraph::MissingTime;
+            }
+
+            std::lock_guard<std::mutex> lock{ m_Mutex };
+            m_Items.push_back(std::move(item));
+            if (m_Groups.size() <= Group)
+            {
+                m_Groups.resize(Group + 1ull);
+            }
+            m_Groups[Group].push_back((uint32_t)(m_Items.size() - 1ull));
+            if (m_pEvents)
+            {
+                m_pEvents->Notify();
+            }
+        }
+
+        // Thread-safe. Nothing is pushed after this.
+        void Close() noexcept
+        {
+            std::lock_guard<std::mutex> lock{ m_Mutex };
+            m_Closed = true;
+            if (m_pEvents)
+            {
+                m_pEvents->Notify();
+            }
+        }
+
+        // Wakes `pEvents` whenever something is pushed (nullptr = no longer)
+        void Attach(JobEvents* pEvents) noexcept
+        {
+            std::lock_guard<std::mutex> lock{ m_Mutex };
+            m_pEvents = pEvents;
+            if (m_pEvents)
+            {
+                m_pEvents->Notify();
+            }
+        }
+
+        // The items pushed since the last call (they stay where they are). Returns false once closed: these are the last.
+        bool Take(List<const Item*>& Items) noexcept
+        {
+            std::lock_guard<std::mutex> lock{ m_Mutex };
+            Items.clear();
+            for (; m_Taken < m_Items.size(); m_Taken++)
+            {
+                Items.push_back(&m_Items[m_Taken]);
+            }
+            return !m_Closed;
+        }
+
+        // Indices (in push order) of the group's items, once closed
+        const List<uint32_t>& GetGroup(uint32_t Group) const noexcept
+        {
+            static const List<uint32_t> s_Empty = {};
+            return Group < m_Groups.size() ? m_Groups[Group] : s_Empty;
+        }
+
+    private:
+        std::mutex m_Mutex = {};
+        std::deque<Item> m_Items = {}; // Doesn't move them when it grows
+        List<List<uint32_t>> m_Groups = {};
+        size_t m_Taken = 0;
+        JobEvents* m_pEvents = nullptr;
+        bool m_Closed = false;
+    };
+
+
+    // Runs the job graph with up to `Jobs` processes at a time. Of the jobs that are ready,
+    // the one with the longest remaining (critical) path to the final outputs starts first.
+    // A job is only admitted while its predicted peak memory fits in the memory budget, and
+    // jobs that get OOM-killed are retried at a lower concurrency. Jobs in a pool wait aside
+    // while the pool is full, without holding back jobs outside of it. Once `MaxFailures` jobs have
+    // failed the running ones are killed and the build stops; until then only the jobs that depend
+    // on a failed one are skipped. Given a feed, compiles start while the projects are still being planned,
+    // and the rest of the graph joins in once they are (see `Run(CompileFeed&, ...)`). While there are more
+    // ready jobs than free slots, small compiles with the same flags are batched into one compiler process.
+    class Executor
+    {
+    public:
+        // Compile commands longer than this go through a response file too (cmd.exe's limit is 8191)
+        static inline constexpr size_t MaxCommandLength = 8000;
+        // Compiles expected to take at most `BatchMaxJobMs` can share one compiler process, as long as
+        // the whole batch is expected to take at most `BatchBudgetMs`
+        static inline constexpr uint32_t BatchMaxJobMs = 200;
+        static inline constexpr uint64_t BatchBudgetMs = 1000;
+        static inline constexpr size_t BatchScanCount = 64; // Ready jobs looked at for a batch
+
+        inline Executor(JobGraph& Graph, BuildDatabase& Db, const ExecutionOptions& Options) noexcept
+            : m_Graph{ Graph }, m_Db{ Db }, m_Options{ Options }
+        { }
+
+        int32_t Run() noexcept
+        {
+            return Run(nullptr, nullptr);
+        }
+
+        // Starts with an empty graph, and adds the compiles from `Feed` as they come (the dirty ones start right
+        // away). Once the feed is closed, `OnPlanned` completes and checks the rest of the graph, then the build
+        // goes on with all of it. If it returns an error, nothing else starts.
+        int32_t Run(CompileFeed& Feed, const std::function<int32_t()>& OnPlanned) noexcept
+        {
+            return Run(&Feed, &OnPlanned);
+        }
+
+    private:
+        struct BatchBase
+        {
+            std::string Name = {}; // The compiler, absolute (empty if it wasn't found)
+            std::shared_ptr<const List<std::string>> Prefix = {}; // The project's flags, with absolute paths (null if it can't batch)
+        };
+
+        struct Batch
+        {
+            Command Cmd = {};
+            List<uint32_t> Members = {}; // The leader (whose job index the batch runs under) first
+            uint64_t PeakRssKb = 0;
+        };
+
+        int32_t Run(CompileFeed* pFeed, const std::function<int32_t()>* pOnPlanned) noexcept
+        {
+            using Clock = std::chrono::steady_clock;
+
+            static constexpr uint32_t kMaxRetries = 3;
+
+            JobTable& jobs = m_Graph.GetJobs();
+            uint32_t kMaxRunning = m_Options.Jobs ? m_Options.Jobs : Platform::GetCpuCount();
+
+            // Every job past the first needs a token. Under a parent make, its jobserver is the limit (unless -j was given).
+            Jobserver jobserver = {};
+            const bool bJobserver = jobserver.Setup(kMaxRunning);
+            if (bJobserver && jobserver.IsClient() && !m_Options.Jobs)
+            {
+                kMaxRunning = UINT32_MAX;
+            }
+            const uint64_t kBudgetKb = m_Options.MemoryBudgetKb ? m_Options.MemoryBudgetKb : Platform::GetAvailableMemoryKb();
+
+            ReadyQueue ready{ jobs.CriticalPathMs };
+            size_t kTotal = 0;
+            for (uint32_t kIndex = 0; kIndex < jobs.GetCount(); kIndex++)
+            {
+                if (jobs.State[kIndex] == JobState::Dirty)
+                {
+                    kTotal++;
+                    if (jobs.DependencyCount[kIndex] == 0)
+                    {
+                        ready.Push(kIndex);
+                    }
+                }
+            }
+
+            const List<uint32_t>& poolDepths = m_Graph.GetPoolDepths();
+            List<uint32_t> poolRunning(poolDepths.size());
+            List<ReadyQueue> poolDelayed(poolDepths.size(), ReadyQueue{ jobs.CriticalPathMs }); // Ready, but their pool is full
+
+            JobEvents events{ jobs.GetCount() };
+            StatusPrinter printer{ kTotal, m_Options.Verbose };
+            if (kTotal == 0 && !pFeed)
+            {
+                printer.Message("Nothing to be done, everything is up to date");
+            }
+#if !defined(CBUILD_LINUX)
+            List<std::thread> threads(jobs.GetCount());
+#endif // !CBUILD_LINUX
+
+            int32_t br = 0;
+            size_t kRunning = 0, kFinished = 0;
+            uint64_t kCommittedKb = 0;
+            uint32_t kInterruptsHandled = 0, kFailures = 0;
+            bool bStopping = false; // Too many failures: like an interrupt, but the running jobs only get asked once
+            bool bPlanning = pFeed != nullptr;
+            bool bComplete = !bPlanning; // The graph has its edges
+            List<const CompileFeed::Item*> streamed = {};
+            Map<uint32_t, Batch> batches = {}; // Running, by their leader
+            List<uint8_t> unbatched = {}; // Jobs that run on their own (their batch did not compile them)
+            bool bBatching = m_Options.MaxBatch > 1 && !m_Options.BypassDriver;
+            if (pFeed)
+            {
+                pFeed->Attach(&events);
+            }
+            while (kFinished < kTotal || bPlanning)
+            {
+                // Interrupted: stop starting jobs, ask the running ones to stop (insist the second time) and wait for them
+                const uint32_t kInterrupts = events.GetInterruptCount();
+                if (kInterrupts)
+                {
+#if defined(CBUILD_LINUX)
+                    if (kInterrupts != kInterruptsHandled)
+                    {
+                        events.KillAll(kInterruptsHandled ? SIGKILL : SIGTERM);
+                        kInterruptsHandled = kInterrupts;
+                    }
+#endif // CBUILD_LINUX
+                    br = BuildResult::BuildInterrupted;
+                }
+                const bool bCancelled = kInterrupts || bStopping;
+                if (bCancelled && kRunning == 0)
+                {
+                    break;
+                }
+
+                if (bPlanning)
+                {
+                    bPlanning = pFeed->Take(streamed);
+                    for (const CompileFeed::Item* pItem : streamed)
+                    {
+                        const uint32_t kIndex = m_Graph.AddStreamed(&pItem->Cmd, pItem->Pool, m_Db, pItem->OutputTime, pItem->InputTime, pItem->CommandHash);
+                        if (jobs.State[kIndex] == JobState::Dirty)
+                        {
+                            kTotal++;
+                            ready.Push(kIndex);
+                        }
+                    }
+                    events.Grow(jobs.GetCount());
+#if !defined(CBUILD_LINUX)
+                    threads.resize(jobs.GetCount());
+#endif // !CBUILD_LINUX
+
+                    if (!bPlanning)
+                    {
+                        // The rest of the graph, then what it makes of the jobs that already ran
+                        pFeed->Attach(nullptr);
+                        if (const int32_t kResult = (*pOnPlanned)(); kResult != 0)
+                        {
+                            br = kResult;
+                            bStopping = true; // The running compiles are left to finish
+                            continue;
+                        }
+                        bComplete = true;
+                        events.Grow(jobs.GetCount());
+#if !defined(CBUILD_LINUX)
+                        threads.resize(jobs.GetCount());
+#endif // !CBUILD_LINUX
+                        kTotal = 0;
+                        for (uint32_t kIndex = 0; kIndex < jobs.GetCount(); kIndex++)
+                        {
+                            kTotal += jobs.State[kIndex] != JobState::Clean;
+                        }
+                        for (uint32_t kIndex = 0; kIndex < m_Graph.GetStreamedCount(); kIndex++)
+                        {
+                            if (jobs.State[kIndex] == JobState::Failed)
+                            {
+                                kFinished += SkipDependents(kIndex);
+                            }
+                        }
+
+                        // The streamed jobs that are still waiting get their real critical paths
+                        List<uint32_t> waiting = {};
+                        for (; !ready.IsEmpty(); ready.Pop())
+                        {
+                            waiting.push_back(ready.Top());
+                        }
+                        for (uint32_t kIndex = (uint32_t)m_Graph.GetStreamedCount(); kIndex < jobs.GetCount(); kIndex++)
+                        {
+                            if (jobs.State[kIndex] == JobState::Dirty && jobs.DependencyCount[kIndex] == 0)
+                            {
+                                waiting.push_back(kIndex);
+                            }
+                        }
+                        for (const uint32_t kIndex : waiting)
+                        {
+                            ready.Push(kIndex);
+                        }
+                    }
+
+                    printer.SetTotal(kTotal);
+                    if (!bPlanning && kTotal == 0)
+                    {
+                        printer.Message("Nothing to be done, everything is up to date");
+                    }
+                    if (!bPlanning && kFinished >= kTotal)
+                    {
+                        continue;
+                    }
+                }
+
+                // Like `make -l`, at least one job always runs, however busy the machine is
+                const bool bThrottled = (m_Options.MaxLoad > 0.0 || m_Options.MaxCpuPressure > 0.0) && kRunning > 0
+                    && Platform::IsOverloaded(m_Options.MaxLoad, m_Options.MaxCpuPressure);
+                bool bWaitingForToken = false;
+
+                while (!bCancelled && !bThrottled && kRunning < kMaxRunning && !ready.IsEmpty())
+                {
+                    const uint32_t kIndex = ready.Top();
+                    const Command& cmd = *jobs.Cmd[kIndex];
+                    const int32_t kPool = jobs.Pool[kIndex];
+
+                    if (kPool >= 0 && poolRunning[kPool] >= poolDepths[kPool])
+                    {
+                        ready.Pop();
+                        poolDelayed[kPool].Push(kIndex);
+                        continue;
+                    }
+
+                    // Wait for memory to free up rather than skip ahead, so big jobs are not starved.
+                    // A job always runs when nothing else is running, however much it needs.
+                    if (kBudgetKb && kRunning && kCommittedKb + jobs.PeakRssKb[kIndex] > kBudgetKb)
+                    {
+                        break;
+                    }
+                    if (bJobserver && kRunning >= 1ull + jobserver.GetTokenCount() && !jobserver.TryAcquire())
+                    {
+                        bWaitingForToken = true;
+                        break;
+                    }
+                    ready.Pop();
+                    if (kPool >= 0)
+                    {
+                        poolRunning[kPool]++;
+                    }
+
+                    // While more jobs are ready than slots are free, small compiles with the same flags share one compiler
+                    // process, which saves starting one (and its driver) for all but one of them. There are no more
+                    // of them than it takes for the free slots to get through the ready jobs, so it costs no parallelism.
+                    // Without the driver there is nothing to save.
+                    const Command* pCmd = &cmd;
+                    std::string workingDir = {};
+                    uint64_t kPeakRssKb = jobs.PeakRssKb[kIndex];
+                    const size_t kFree = kMaxRunning - kRunning;
+                    if (bBatching && ready.GetCount() >= kFree && CanBatch(kIndex, unbatched))
+                    {
+                        // Each of them counts against the pool, as if it ran on its own
+                        size_t kMaxCount = std::min<size_t>(m_Options.MaxBatch, (ready.GetCount() + kFree) / kFree);
+                        if (kPool >= 0)
+                        {
+                            kMaxCount = std::min<size_t>(kMaxCount, 1ull + poolDepths[kPool] - poolRunning[kPool]);
+                        }
+                        List<uint32_t> members = CollectBatch(kIndex, ready, kMaxCount, unbatched);
+                        if (members.size() > 1)
+                        {
+                            if (kPool >= 0)
+                            {
+                                poolRunning[kPool] += (uint32_t)members.size() - 1u;
+                            }
+                            Batch& batch = batches[kIndex];
+                            workingDir = cmd.Output + ".batch";
+                            batch.Cmd = MakeBatchCommand(members, workingDir);
+                            for (const uint32_t kMember : members)
+                            {
+                                batch.PeakRssKb = std::max(batch.PeakRssKb, jobs.PeakRssKb[kMember]);
+                            }
+                            batch.Members = std::move(members);
+
+                            std::error_code ec = {};
+                            std::filesystem::remove_all(workingDir, ec); // Left behind by a killed cbuild
+                            std::filesystem::create_directories(workingDir, ec);
+                            pCmd = &batch.Cmd;
+                            kPeakRssKb = batch.PeakRssKb;
+                        }
+                    }
+
+                    printer.JobStarted(*pCmd, kFinished);
+
+                    kRunning++;
+                    kCommittedKb += kPeakRssKb;
+                    RemoveFile(cmd.TempOutput); // Left behind by a killed cbuild (and `ar` would add to it)
+                    const Clock::time_point tStart = Clock::now();
+                    const std::string responseFile = PrepareResponseFile(*pCmd);
+#if defined(CBUILD_LINUX)
+                    // Spawned from here, so that only our own (close-on-exec) end of each pipe is left open
+                    const int iOutputFd = events.OpenOutput(kIndex);
+                    List<std::string> compiler = {}, assembler = {};
+                    pid_t kCompilerPid = -1;
+                    const pid_t kPid = m_Options.BypassDriver && pCmd == &cmd && m_Driver.Resolve(cmd, compiler, assembler)
+                        ? Process::SpawnPipeline(compiler, assembler, iOutputFd, kCompilerPid)
+                        : Process::Spawn(*pCmd, iOutputFd, responseFile, workingDir);
+                    if (iOutputFd >= 0)
+                    {
+                        close(iOutputFd);
+                    }
+                    if (kPid < 0)
+                    {
+                        if (pCmd != &cmd)
+                        {
+                            // Its compiles run again on their own (which shows why, if they fail too), and so do the rest
+                            printer.Message(std::format("[WARNING]: Failed to start `{}` for a batch of {} compiles, no longer batching them",
+                                pCmd->Name, batches[kIndex].Members.size()));
+                            bBatching = false;
+                        }
+                        events.Post({ kIndex, { .ExitCode = BuildResult::CommandProcessFailed } });
+                        continue;
+                    }
+                    events.WatchProcess(kIndex, kPid, tStart, kCompilerPid);
+#else
+                    threads[kIndex] = std::thread([&events, pCmd, kIndex, tStart, responseFile, workingDir]() -> void
+                    {
+                        const ProcessResult result = Process::Run(*pCmd, responseFile, workingDir);
+                        const auto kElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - tStart);
+                        events.Post({ kIndex, result, (uint32_t)kElapsed.count() });
+                    });
+#endif // CBUILD_LINUX
+                }
+
+                if (kRunning == 0 && !bPlanning)
+                {
+                    // Nothing is running and nothing is ready (can only happen with a cyclic graph)
+                    CBUILD_ASSERT(false, "Job graph stalled");
+                    break;
+                }
+
+                if (bWaitingForToken)
+                {
+                    events.WatchOnce(jobserver.GetReadFd());
+                }
+
+                // When throttled, check the load again shortly, even if nothing finishes
+                const List<Completion> done = events.Wait(bThrottled ? 250 : -1);
+
+                // Reports a job that is over (its output in place), and records it or fails it
+                const auto Finish = [&](uint32_t Index, const ProcessResult& Result, uint32_t DurationMs, const std::string& Output) -> void
+                {
+                    const Command& cmd = *jobs.Cmd[Index];
+                    kFinished++;
+                    if (!bCancelled && !bStopping)
+                    {
+                        // Jobs we killed ourselves are not worth reporting
+                        printer.JobFinished(cmd, kFinished, Result.ExitCode != 0, Output);
+                    }
+
+                    if (Result.ExitCode == 0)
+                    {
+                        NodeRecord& record = m_Db.Touch(cmd.Output);
+                        record.DurationMs = DurationMs;
+                        record.PeakRssKb = Result.PeakRssKb;
+                        record.CommandHash = HashCommand(cmd);
+                        if (!cmd.Depfile.empty())
+                        {
+                            m_Db.SetHeaders(cmd.Output, ReadDepfile(cmd.Depfile, cmd.Input));
+                            if (cmd.Depfile != cmd.Output)
+                            {
+                                RemoveFile(cmd.Depfile);
+                            }
+                        }
+                        m_Db.Journal(cmd.Output);
+                        jobs.State[Index] = JobState::Done;
+                    }
+                    else
+                    {
+                        if (br == 0 || br == BuildResult::WksBuildFailed)
+                        {
+                            br = BuildResult::WksBuildFailed;
+                        }
+
+                        // Nothing that depends on a failed job can succeed, so none of it runs (without the
+                        // rest of the graph yet, that is left to when it is there)
+                        jobs.State[Index] = JobState::Failed;
+                        if (bComplete)
+                        {
+                            kFinished += SkipDependents(Index);
+                        }
+
+                        if (!bStopping && m_Options.MaxFailures && ++kFailures >= m_Options.MaxFailures)
+                        {
+                            bStopping = true;
+#if defined(CBUILD_LINUX)
+                            events.KillAll(SIGTERM);
+#endif // CBUILD_LINUX
+                        }
+                        return;
+                    }
+
+                    for (const uint32_t kDependent : bComplete ? m_Graph.GetDependents(Index) : std::span<const uint32_t>{})
+                    {
+                        if (--jobs.DependencyCount[kDependent] == 0 && jobs.State[kDependent] != JobState::Skipped)
+                        {
+                            ready.Push(kDependent);
+                        }
+                    }
+                };
+
+                for (const Completion& c : done)
+                {
+#if !defined(CBUILD_LINUX)
+                    if (threads[c.Index].joinable())
+                    {
+                        threads[c.Index].join();
+                    }
+#endif // !CBUILD_LINUX
+                    kRunning--;
+
+                    const Command& cmd = *jobs.Cmd[c.Index];
+                    const int32_t kPool = jobs.Pool[c.Index];
+                    const std::string output = events.TakeOutput(c.Index);
+
+                    const auto it = batches.find(c.Index);
+                    if (kPool >= 0)
+                    {
+                        const uint32_t kSteps = it != batches.end() ? (uint32_t)it->second.Members.size() : 1u;
+                        poolRunning[kPool] -= kSteps;
+                        for (uint32_t kStep = 0; kStep < kSteps && !poolDelayed[kPool].IsEmpty(); kStep++)
+                        {
+                            ready.Push(poolDelayed[kPool].Top());
+                            poolDelayed[kPool].Pop();
+                        }
+                    }
+
+                    // Of a batch, the members it compiled are done (their objects were complete, unless it was killed).
+                    // The others run again on their own: that pins a failure on its source, and shows its errors.
+                    // So the batch's own output is only shown when all of it compiled.
+                    if (it != batches.end())
+                    {
+                        const Batch& batch = it->second;
+                        const bool bExited = c.Result.ExitCode >= 0 && !c.Result.Killed;
+                        kCommittedKb -= batch.PeakRssKb;
+
+                        uint64_t kEstimateMs = 0;
+                        for (const uint32_t kMember : batch.Members)
+                        {
+                            kEstimateMs += jobs.EstimateMs[kMember];
+                        }
+                        for (const uint32_t kMember : batch.Members)
+                        {
+                            const Command& member = *jobs.Cmd[kMember];
+                            std::error_code ec = {};
+                            if (bExited)
+                            {
+                                std::filesystem::rename(GetBatchFilepath(batch.Cmd.Output, member, ".o"), member.Output, ec);
+                                if (!ec)
+                                {
+                                    std::filesystem::rename(GetBatchFilepath(batch.Cmd.Output, member, ".d"), member.Depfile, ec);
+                                }
+                            }
+
+                            if (bExited && !ec)
+                            {
+                                // Its share of the time, by what it was expected to take
+                                const uint32_t kDurationMs = (uint32_t)(c.DurationMs * jobs.EstimateMs[kMember] / std::max<uint64_t>(kEstimateMs, 1ull));
+                                Finish(kMember, { .PeakRssKb = c.Result.PeakRssKb }, kDurationMs, c.Result.ExitCode == 0 && kMember == batch.Members.front() ? output : std::string{});
+                            }
+                            else if (bCancelled || bStopping)
+                            {
+                                Finish(kMember, { .ExitCode = BuildResult::CommandProcessFailed }, 0, {});
+                            }
+                            else
+                            {
+                                unbatched.resize(std::max<size_t>(unbatched.size(), kMember + 1ull));
+                                unbatched[kMember] = 1;
+                                ready.Push(kMember);
+                            }
+                        }
+
+                        std::error_code ec = {};
+                        std::filesystem::remove_all(batch.Cmd.Output, ec);
+                        batches.erase(it);
+                        continue;
+                    }
+                    kCommittedKb -= jobs.PeakRssKb[c.Index];
+
+                    // Outputs are written to a temporary file, which only becomes the output once complete
+                    ProcessResult result = c.Result;
+                    if (result.ExitCode == 0 && !cmd.TempOutput.empty())
+                    {
+                        std::error_code ec = {};
+                        std::filesystem::rename(cmd.TempOutput, cmd.Output, ec);
+                        if (ec)
+                        {
+                            result.ExitCode = BuildResult::CommandProcessFailed;
+                        }
+                    }
+                    if (result.ExitCode != 0)
+                    {
+                        RemoveFile(cmd.TempOutput);
+                        RemoveFile(cmd.Depfile);
+                        if (m_Options.DeleteFailedOutputs && !bCancelled && !bStopping)
+                        {
+                            RemoveFile(cmd.Output);
+                        }
+                    }
+
+                    if (result.Killed && !bCancelled && !bStopping && jobs.Retries[c.Index] < kMaxRetries && (kRunning > 0 || kMaxRunning > 1))
+                    {
+                        // Most likely OOM-killed: expect it to need more, run fewer jobs beside it and try again
+                        jobs.Retries[c.Index]++;
+                        jobs.PeakRssKb[c.Index] = std::max<uint64_t>(jobs.PeakRssKb[c.Index] * 2ull, result.PeakRssKb);
+                        kMaxRunning = std::max(1u, std::min(kMaxRunning, (uint32_t)kRunning + 1u) / 2u);
+                        printer.Message(std::format("[WARNING]: `{}` was killed (out of memory?), retrying with at most {} jobs", cmd.Output, kMaxRunning));
+                        ready.Push(c.Index);
+                        continue;
+                    }
+
+                    Finish(c.Index, result, c.DurationMs, output);
+                }
+
+                // Hand back the tokens of finished jobs straight away, other processes may be waiting for them
+                while (bJobserver && jobserver.GetTokenCount() > (kRunning ? kRunning - 1ull : 0ull))
+                {
+                    jobserver.Release();
+                }
+            }
+
+            if (pFeed)
+            {
+                pFeed->Attach(nullptr);
+            }
+            printer.Finish();
+            return br;
+        }
+
+        static void RemoveFile(const std::string& Filepath) noexcept
+        {
+            if (!Filepath.empty())
+            {
+                std::error_code ec = {};
+                std::filesystem::remove(Filepath, ec);
+            }
+        }
+
+        // Marks everything that (transitively) depends on the job as skipped. Returns how many were newly skipped.
+        size_t SkipDependents(uint32_t Index) noexcept
+        {
+            JobTable& jobs = m_Graph.GetJobs();
+            List<uint32_t> stack{ Index };
+            size_t kSkipped = 0;
+            while (!stack.empty())
+            {
+                const uint32_t kIndex = stack.back();
+                stack.pop_back();
+                for (const uint32_t kDependent : m_Graph.GetDependents(kIndex))
+                {
+                    if (jobs.State[kDependent] != JobState::Skipped)
+                    {
+                        jobs.State[kDependent] = JobState::Skipped;
+                        stack.push_back(kDependent);
+                        kSkipped++;
+                    }
+                }
+            }
+            return kSkipped;
+        }
+
+        // Links and archives (and overly long compiles) get their arguments from `<output>.rsp`, which is
+        // only rewritten when the arguments changed. Returns the file's path, or nothing to pass them directly.
+        std::string PrepareResponseFile(const Command& Cmd) noexcept
+        {
+            if (Cmd.Kind == CommandKind::Custom || Cmd.Output.empty())
+            {
+                return {};
+            }
+
+            Utils::Fnv1a hash = {};
+            size_t kLength = Cmd.Name.size();
+            Cmd.ForEachArg([&hash, &kLength](const std::string& arg)
+            {
+                hash.Add(arg);
+                kLength += arg.size() + 1ull;
+            });
+
+            if (Cmd.Kind == CommandKind::Compile && kLength <= MaxCommandLength)
+            {
+                return {};
+            }
+
+            namespace stdfs = std::filesystem;
+
+            const std::string filepath = Cmd.Output + ".rsp";
+            NodeRecord& record = m_Db.Touch(Cmd.Output);
+            std::error_code ec = {};
+            if (record.ResponseFileHash == hash.Value && stdfs::exists(filepath, ec))
+            {
+                return filepath;
+            }
+
+            const std::string tmpFilepath = filepath + ".tmp";
+            {
+                std::ofstream ofs{ tmpFilepath, std::ios::binary | std::ios::trunc };
+                const std::string text = Process::ToResponseFile(Cmd);
+                if (!ofs || !ofs.write(text.data(), (std::streamsize)text.size()))
+                {
+                    return {};
+                }
+            }
+
+            stdfs::rename(tmpFilepath, filepath, ec);
+            if (ec)
+            {
+                return {};
+            }
+
+            record.ResponseFileHash = hash.Value;
+            return filepath;
+        }
+
+        // Compiles that ran (and will run) fine apart from their own flags and source. Checks (whose output is
+        // their depfile) write nothing a batch could steer into place.
+        // Also, a batch runs in a directory of its own, so the compiler and the paths in its flags must be found from there.
+        bool CanBatch(uint32_t Index, const List<uint8_t>& Unbatched) noexcept
+        {
+            const JobTable& jobs = m_Graph.GetJobs();
+            const Command& cmd = *jobs.Cmd[Index];
+            return jobs.Kind[Index] == CommandKind::Compile && cmd.Prefix && !cmd.Depfile.empty() && cmd.Depfile != cmd.Output
+                && jobs.EstimateMs[Index] <= BatchMaxJobMs && jobs.Retries[Index] == 0 && !(Index < Unbatched.size() && Unbatched[Index])
+                && GetBatchBase(cmd).Prefix;
+        }
+
+        // Takes up to `MaxCount` - 1 ready compiles with the same compiler, flags and pool as `Leader` (off the top of
+        // the queue, so nothing more urgent waits for them) into its batch. Returns the batch, `Leader` first.
+        List<uint32_t> CollectBatch(uint32_t Leader, ReadyQueue& Ready, size_t MaxCount, const List<uint8_t>& Unbatched) noexcept
+        {
+            const JobTable& jobs = m_Graph.GetJobs();
+            const Command& leader = *jobs.Cmd[Leader];
+
+            List<uint32_t> members{ Leader };
+            List<uint32_t> passed = {};
+            uint64_t kEstimateMs = jobs.EstimateMs[Leader];
+            // With `-c`, its source and where its debug info says it was compiled
+            size_t kLength = GetBatchBase(leader).Name.size() + 3ull * m_Cwd.size() + leader.Input.size() + leader.Output.size() + 40ull;
+            for (const std::string& arg : *GetBatchBase(leader).Prefix)
+            {
+                kLength += arg.size() + 1ull;
+            }
+            for (size_t kScanned = 0; kScanned < BatchScanCount && members.size() < MaxCount && !Ready.IsEmpty(); kScanned++)
+            {
+                const uint32_t kIndex = Ready.Top();
+                Ready.Pop();
+
+                const Command& cmd = *jobs.Cmd[kIndex];
+                const size_t kArgLength = m_Cwd.size() + cmd.Input.size() + 1ull;
+                if (CanBatch(kIndex, Unbatched) && cmd.Prefix == leader.Prefix && cmd.Name == leader.Name && jobs.Pool[kIndex] == jobs.Pool[Leader]
+                    && kEstimateMs + jobs.EstimateMs[kIndex] <= BatchBudgetMs && kLength + kArgLength <= MaxCommandLength)
+                {
+                    members.push_back(kIndex);
+                    kEstimateMs += jobs.EstimateMs[kIndex];
+                    kLength += kArgLength;
+                }
+                else
+                {
+                    passed.push_back(kIndex);
+                }
+            }
+            for (const uint32_t kIndex : passed)
+            {
+                Ready.Push(kIndex);
+            }
+            return members;
+        }
+
+        // `cc -c <sources>...`, run in `Dir`: each object (and depfile) is named after its source, there. For the other
+        // working directory, the compiler, the paths in the flags and the sources are made absolute, and mapped back in
+        // what ends up in the objects (__FILE__, debug info) so that they are the same as from compiles of their own.
+        Command MakeBatchCommand(const List<uint32_t>& Members, const std::string& Dir) noexcept
+        {
+            const JobTable& jobs = m_Graph.GetJobs();
+            const Command& leader = *jobs.Cmd[Members.front()];
+
+            // Lists the sources as its input, for the status line. Compiled here, as far as the debug info goes
+            // (GCC goes by the last map that matches).
+            const std::string dir = std::filesystem::path{ Dir }.is_absolute() ? Dir : m_Cwd + Dir;
+            const std::string compileDir = m_Cwd.substr(0, m_Cwd.size() - 1ull);
+            const BatchBase& base = GetBatchBase(leader);
+            Command cmd = {
+                .Name = base.Name,
+                .Prefix = base.Prefix,
+                .Args = { std::format("-fdebug-prefix-map={}={}", dir, compileDir), "-c" },
+                .Kind = CommandKind::Compile,
+                .Output = Dir,
+            };
+            for (const uint32_t kIndex : Members)
+            {
+                const std::string& input = jobs.Cmd[kIndex]->Input;
+                cmd.Args.push_back(std::filesystem::path{ input }.is_absolute() ? input : m_Cwd + input);
+                cmd.Input += (cmd.Input.empty() ? "" : " ") + input;
+            }
+            return cmd;
+        }
+
+        // The compiler and the project's flags of a batch, independent of the working directory (cached per project).
+        // No prefix if that can't be done: an argument that isn't an option, or one with a relative path it doesn't know.
+        const BatchBase& GetBatchBase(const Command& Leader) noexcept
+        {
+            namespace stdfs = std::filesystem;
+
+            // Options that take a path: `-I<dir>` or `-I <dir>`
+            static const std::string_view s_PathOptions[] =
+            {
+                "-I", "-iquote", "-isystem", "-idirafter", "-include", "-imacros", "-isysroot", "--sysroot=", "--sysroot", "-L", "-B", "-specs=",
+            };
+
+            const auto [it, bInserted] = m_BatchBases.try_emplace(Leader.Prefix.get());
+            BatchBase& base = it->second;
+            if (!bInserted)
+            {
+                return base;
+            }
+
+            base.Name = FindProgram(Leader.Name);
+            if (base.Name.empty())
+            {
+                return base;
+            }
+
+            const auto MakeAbsolute = [this](std::string_view Path) -> std::string
+            {
+                return Path.empty() || stdfs::path{ Path }.is_absolute() ? std::string{ Path } : m_Cwd + std::string{ Path };
+            };
+            const List<std::string>& args = *Leader.Prefix;
+            List<std::string> prefix = {};
+            for (size_t kIndex = 0; kIndex < args.size(); kIndex++)
+            {
+                const std::string& arg = args[kIndex];
+                const auto option = std::find_if(std::begin(s_PathOptions), std::end(s_PathOptions), [&arg](std::string_view Option)
+                {
+                    return arg.starts_with(Option);
+                });
+
+                if (option != std::end(s_PathOptions) && arg.size() == option->size() && !option->ends_with('='))
+                {
+                    if (kIndex + 1ull == args.size())
+                    {
+                        return base;
+                    }
+                    prefix.push_back(arg);
+                    prefix.push_back(MakeAbsolute(args[++kIndex]));
+                }
+                else if (option != std::end(s_PathOptions))
+                {
+                    prefix.push_back(std::string{ *option } + MakeAbsolute(std::string_view{ arg }.substr(option->size())));
+                }
+                else if (arg.starts_with('@'))
+                {
+                    prefix.push_back("@" + MakeAbsolute(std::string_view{ arg }.substr(1ull)));
+                }
+                else if (!arg.starts_with('-'))
+                {
+                    return base;
+                }
+                else
+                {
+                    // `-fsomething=<path>`: fine as long as it isn't a relative path (to something that exists)
+                    const size_t kEquals = arg.find('=');
+                    const std::string value = kEquals != std::string::npos ? arg.substr(kEquals + 1ull) : std::string{};
+                    std::error_code ec = {};
+                    if (!value.empty() && !stdfs::path{ value }.is_absolute() && stdfs::exists(m_Cwd + value, ec))
+                    {
+                        return base;
+                    }
+                    prefix.push_back(arg);
+                }
+            }
+            prefix.push_back(std::format("-ffile-prefix-map={}=", m_Cwd));
+
+            base.Prefix = std::make_shared<const List<std::string>>(std::move(prefix));
+            return base;
+        }
+
+        // Where spawning `Name` from our working directory finds it (made absolute), empty if nowhere
+        std::string FindProgram(const std::string& Name) const noexcept
+        {
+            namespace stdfs = std::filesystem;
+
+            const auto IsProgram = [](const std::string& Filepath) -> bool
+            {
+                std::error_code ec = {};
+#if defined(CBUILD_LINUX)
+                return stdfs::is_regular_file(Filepath, ec) && access(Filepath.c_str(), X_OK) == 0;
+#else
+                return stdfs::is_regular_file(Filepath, ec) || stdfs::is_regular_file(Filepath + ".exe", ec);
+#endif // CBUILD_LINUX
+            };
+
+            if (Name.empty())
+            {
+                return {};
+            }
+            if (Name.find_first_of("/" CBUILD_PATH_SEP) != std::string::npos)
+            {
+                const std::string filepath = stdfs::path{ Name }.is_absolute() ? Name : m_Cwd + Name;
+                return IsProgram(filepath) ? filepath : std::string{};
+            }
+
+            // Like posix_spawnp: each directory in PATH in turn (an empty one, or a relative one, is from the working directory)
+#if defined(CBUILD_LINUX)
+            constexpr char kListSeparator = ':';
+            const char* lpPath = getenv("PATH");
+            const std::string_view path{ lpPath ? lpPath : "/bin:/usr/bin" };
+#else
+            constexpr char kListSeparator = ';';
+            const char* lpPath = getenv("PATH");
+            const std::string path = std::string{ ".;" } + (lpPath ? lpPath : ""); // cmd looks in the working directory first
+#endif // CBUILD_LINUX
+            size_t kBegin = 0;
+            while (kBegin <= path.size())
+            {
+                const size_t kEnd = std::min(path.find(kListSeparator, kBegin), path.size());
+                const std::string dir{ path.substr(kBegin, kEnd - kBegin) };
+                const std::string base = dir.empty() ? m_Cwd : (stdfs::path{ dir }.is_absolute() ? dir : m_Cwd + dir) + CBUILD_PATH_SEP;
+                if (IsProgram(base + Name))
+                {
+                    return base + Name;
+                }
+                kBegin = kEnd + 1ull;
+            }
+            return {};
+        }
+
+        // Where each member of a batch (run in `Dir`) writes `Extension`
+        static std::string GetBatchFilepath(const std::string& Dir, const Command& Member, const char* lpExtension) noexcept
+        {
+            return (std::filesystem::path{ Dir } / std::filesystem::path{ Member.Input }.stem()).string() + lpExtension;
+        }
+
+    private:
+        JobGraph& m_Graph;
+        BuildDatabase& m_Db;
+        const ExecutionOptions& m_Options;
+        const std::string m_Cwd = []() -> std::string
+        {
+            std::error_code ec = {};
+            return (std::filesystem::current_path(ec) / "").string(); // With a trailing separator
+        }();
+        Map<const List<std::string>*, BatchBase> m_BatchBases = {};
+#if defined(CBUILD_LINUX)
+        DriverBypass m_Driver = {};
+#endif // CBUILD_LINUX
+    };
+
+}
+
+
+namespace Cbuild::Builders
+{
+
+    // The file a project's final step makes
+    static std::string MakeOutputFilepath(const Project& p, const char* lpConfiguration) noexcept
+    {
+        const char* ext = p.OutputKind == BuildOutputKind::ConsoleApp ? "exe"
+            : p.OutputKind == BuildOutputKind::StaticLibrary ? "lib" : CBUILD_SHARED_LIB_EXT;
+        return std::format("{}" CBUILD_PATH_SEP "{}" CBUILD_PATH_SEP "{}.{}", p.Wks->OutputDir, lpConfiguration, p.Name, ext);
+    }
+
+
+    class ConsoleAppBuilder : public IProjectBuilder
+    {
+    public:
+        inline ConsoleAppBuilder(const Project* pProject)
+        {
+            m_Project = pProject;
+        }
+
+        inline virtual ~ConsoleAppBuilder() noexcept override = default;
+
+        virtual int32_t Plan(const char* lpConfiguration) noexcept override
+        {
+            CBUILD_ASSERT(!m_Project->Configurations.empty(), "No configurations defined!");
+            CBUILD_ASSERT(lpConfiguration && *lpConfiguration, "Invalid configuration");
+
+            const auto it = m_Project->Configurations.find(std::string_view{ lpConfiguration });
+            if (it == m_Project->Configurations.end())
+            {
+                printf("[ERROR]: Configuration `%s` was not found (check if it was defined and try again)\n", lpConfiguration);
+                return BuildResult::CommandProcessFailed;
+            }
+
+            const Configuration& config = it->second;
+            const std::string outputFilename = MakeOutputFilepath(*m_Project, lpConfiguration);
+
+            const auto PrepareBaseCommand = [this, &config]() -> Command
+            {
+                // <CC> (-D <DEF> ...) (-I <INC> ...) (-L <LIBDIR> ...) (-l <LIB> ...) (<OPTS> ...) (<IN> ...)
+                Command cmd = { .Name = std::string{ m_Project->Compiler } };
+
+                // Defines
+                for (const auto& def : m_Project->Defines)
+                {
+                    cmd.Args.push_back(std::format("-D{}", def));
+                }
+                for (const auto& def : config.Defines)
+                {
+                    cmd.Args.push_back(std::format("-D{}", def));
+                }
+                // Includes
+                for (const auto& inc : m_Project->IncludeDirs)
+                {
+                    cmd.Args.push_back(std::format("-I{}", inc));
+                }
+                // Options
+                if (m_Project->Arch.size() && m_Project->Arch == "x64")
+                {
+                    cmd.Args.push_back("-m64");
+                }
+                if (m_Project->Language == "C++")
+                {
+                    cmd.Args.push_back(std::format("-std=c++{}", m_Project->CppVersion));
+                }
+                else
+                {
+                    cmd.Args.push_back(std::format("-std=c{}", m_Project->CVersion));
+                }
+                for (const auto& flag : config.Flags)
+                {
+                    cmd.Args.push_back(std::format("-{}", flag));
+                }
+                
+                return cmd;
+            };
+
+            const auto PrepareFinalBuildCommand = [this, &outputFilename]() -> void
+            {
+                Command buildConsoleAppCmd{ .Name = std::string{ m_Project->Compiler }, .Kind = CommandKind::Link, .Output = outputFilename, .TempOutput = Utils::MakeTemporaryFilepath(outputFilename) };
+
+                // For console apps (executables), we link to the libraries when building the actual .exe file
+                // Intermediate Files
+                for (const auto& obj : m_OutputFiles)
+                {
+                    buildConsoleAppCmd.Args.push_back(obj);
+                }
+                // Library & References
+                for (const auto& libdir : m_Project->LibraryDirs)
+                {
+                    buildConsoleAppCmd.Args.push_back(std::format("-L{}", libdir));
+                }
+                for (const auto& ref : m_Project->References)
+                {
+                    buildConsoleAppCmd.Args.push_back(std::format("-l{}", ref));
+                }
+                // Output
+                buildConsoleAppCmd.Args.push_back("-o");
+                buildConsoleAppCmd.Args.push_back(buildConsoleAppCmd.TempOutput);
+                
+                m_Commands.push_back(buildConsoleAppCmd);
+                m_OutputFiles.push_back(outputFilename);
+            };
+
+            GenerateBuildCommandsAndOutputFiles(lpConfiguration, PrepareBaseCommand());
+            PrepareFinalBuildCommand();
+
+            return 0;
+        }
+    };
+
+
+    class LibraryBuilder : public IProjectBuilder
+    {
+    public:
+        inline LibraryBuilder(const Project* pProject)
+        {
+            m_Project = pProject;
+        }
+
+        inline virtual ~LibraryBuilder() noexcept override = default;
+
+        virtual int32_t Plan(const char* lpConfiguration) noexcept override
+        {
+            CBUILD_ASSERT(!m_Project->Configurations.empty(), "No configurations defined!");
+            CBUILD_ASSERT(lpConfiguration && *lpConfiguration, "Invalid configuration");
+
+            const auto it = m_Project->Configurations.find(std::string_view{ lpConfiguration });
+            if (it == m_Project->Configurations.end())
+            {
+                printf("[ERROR]: Configuration `%s` was not found (check if it was defined and try again)\n", lpConfiguration);
+                return BuildResult::CommandProcessFailed;
+            }
+
+            const Configuration& config = it->second;
+            const std::string outputDir = std::format("{}" CBUILD_PATH_SEP "{}", m_Project->Wks->OutputDir, lpConfiguration);
+            const std::string outputFilename = MakeOutputFilepath(*m_Project, lpConfiguration);
+
+            const auto PrepareBaseCommand = [this, &config]() -> Command
+            {
+                // <CC> (-D <DEF> ...) (-I <INC> ...) (-L <LIBDIR> ...) (-l <LIB> ...) (<OPTS> ...) (<IN> ...)
+                Command cmd = { .Name = std::string{ m_Project->Compiler } };
+
+                // Defines
+                for (const auto& def : m_Project->Defines)
+                {
+                    cmd.Args.push_back(std::format("-D{}", def));
+                }
+                for (const auto& def : config.Defines)
+                {
+                    cmd.Args.push_back(std::format("-D{}", def));
+                }
+                // Includes
+                for (const auto& inc : m_Project->IncludeDirs)
+                {
+                    cmd.Args.push_back(std::format("-I{}", inc));
+                }
+                // Library & References
+                for (const auto& libdir : m_Project->LibraryDirs)
+                {
+                    cmd.Args.push_back(std::format("-L{}", libdir));
+                }
+                for (const auto& ref : m_Project->References)
+                {
+                    cmd.Args.push_back(std::format("-l{}", ref));
+                }
+                // Options
+                if (m_Project->Arch.size() && m_Project->Arch == "x64")
+                {
+                    cmd.Args.push_back("-m64");
+                }
+                if (m_Project->Language == "C++")
+                {
+                    cmd.Args.push_back(std::format("-std=c++{}", m_Project->CppVersion));
+                }
+                else
+                {
+                    cmd.Args.push_back(std::format("-std=c{}", m_Project->CVersion));
+                }
+#if defined(CBUILD_LINUX)
+                if (m_Project->OutputKind == BuildOutputKind::SharedLibrary)
+                {
+                    cmd.Args.push_back("-fPIC");
+                }
+#endif // CBUILD_LINUX
+                for (const auto& flag : config.Flags)
+                {
+                    cmd.Args.push_back(std::format("-{}", flag));
+                }
+                
+                return cmd;
+            };
+
+            const auto PrepareFinalBuildCommand = [this, &outputDir, &outputFilename]() -> void
+            {
+                Command buildLibraryCmd = { .Output = outputFilename, .TempOutput = Utils::MakeTemporaryFilepath(outputFilename) };
+                if (m_Project->OutputKind == BuildOutputKind::StaticLibrary)
+                {
+                    buildLibraryCmd.Name = "ar";
+                    buildLibraryCmd.Kind = CommandKind::Archive;
+                    buildLibraryCmd.Args.push_back("-rcs");
+                }
+                else
+                {
+                    buildLibraryCmd.Name = std::string{ m_Project->Compiler };
+                    buildLibraryCmd.Kind = CommandKind::Link;
+                    buildLibraryCmd.Args.push_back("-shared");
+#if defined(CBUILD_WIN32)
+                    buildLibraryCmd.Args.push_back(std::format("-Xlinker --out-implib {}\\{}.lib", outputDir, m_Project->Name));
+#endif // CBUILD_WIN32
+                }
+
+                // Output
+                buildLibraryCmd.Args.push_back("-o");
+                buildLibraryCmd.Args.push_back(buildLibraryCmd.TempOutput);
+                // Intermediate Files
+                for (const auto& obj : m_OutputFiles)
+                {
+                    buildLibraryCmd.Args.push_back(obj);
+                }
+                
+                m_Commands.push_back(buildLibraryCmd);
+                m_OutputFiles.push_back(outputFilename);
+            };
+
+            GenerateBuildCommandsAndOutputFiles(lpConfiguration, PrepareBaseCommand());
+            PrepareFinalBuildCommand();
+
+            return 0;
+        }
+    };
+
+}
+
+
+namespace Cbuild
+{
+
+    static inline constexpr const char* GetVersion() noexcept
+    {
+        // X.X.X
+        return CBUILD_STR(CBUILD_VERSION_MAJOR) "."
+               CBUILD_STR(CBUILD_VERSION_MINOR) "."
+               CBUILD_STR(CBUILD_VERSION_BUILD);
+    }
+
+
+    class Converter
+    {
+    public:
+        static const char* OutputKindToString(BuildOutputKind Kind) noexcept
+        {
+            switch (Kind)
+            {
+                case BuildOutputKind::ConsoleApp:    return "ConsoleApp";
+                case BuildOutputKind::StaticLibrary: return "StaticLibrary";
+                case BuildOutputKind::SharedLibrary: return "SharedLibrary";
+                default: return CBUILD_ASSERT(false, 0), nullptr;
+            }
+        }
+
+        static BuildOutputKind StringToOutputKind(const std::string_view& Value) noexcept
+        {
+            if (Value == "ConsoleApp")    return BuildOutputKind::ConsoleApp;
+            if (Value == "StaticLibrary") return BuildOutputKind::StaticLibrary;
+            if (Value == "SharedLibrary") return BuildOutputKind::SharedLibrary;
+            
+            return static_cast<BuildOutputKind>(-1);
+        }
+
+        static CommandKind StringToCommandKind(const std::string_view& Value) noexcept
+        {
+            if (Value == "Compile") return CommandKind::Compile;
+            if (Value == "Link")    return CommandKind::Link;
+            if (Value == "Archive") return CommandKind::Archive;
+            if (Value == "Custom")  return CommandKind::Custom;
+
+            return static_cast<CommandKind>(-1);
+        }
+    };
+
+
+    class XmlReadHelper
+    {
+    public:
+        // Only elements, attributes and their text are used
+        static inline constexpr unsigned int ParseOptions = pugi::parse_minimal | pugi::parse_escapes | pugi::parse_cdata;
+
+        // Parses in place, the workspace's strings point into `pBuffer` (which must outlive it)
+        static bool LoadWorkspace(Workspace* const pWks, const char* lpXmlFilepath, void* pBuffer, size_t Size) noexcept
+        {
+            CBUILD_ASSERT(lpXmlFilepath, "Invalid filepath");
+
+            pugi::xml_document doc;
+            pugi::xml_parse_result res = doc.load_buffer_inplace(pBuffer, Size, ParseOptions, pugi::encoding_utf8); // Converting would copy
+            CBUILD_ASSERT((bool)res, "Error in parsing `%s`. Description=%s, FileOffset=%I64d", lpXmlFilepath, res.description(), res.offset);
+
+            const pugi::xml_node xWks = doc.document_element();
+
+            // Attributes
+            if (const auto xAttr = xWks.attribute("Name"))
+            {
+                pWks->Name = xAttr.as_string();
+            }
+            else
+            {
+                return false;
+            }
+            
+            // Output Directory
+            if (const auto xOutputDir = xWks.child("OutputDir"))
+            {
+                pWks->OutputDir = xOutputDir.child_value();
+            }
+            else
+            {
+                pWks->OutputDir = "bin";
+            }
+            
+            // Intermediates Directory
+            if (const auto xIntermediateDir = xWks.child("IntermediateDir"))
+            {
+                pWks->IntermediateDir = xIntermediateDir.child_value();
+            }
+            else
+            {
+                pWks->IntermediateDir = "bin-int";
+            }
+            
+            if (const auto xDeleteOutputFiles = xWks.child("DeleteOutputFilesIfBuildFails"))
+            {
+                pWks->DeleteOutputFilesIfBuildFails = xDeleteOutputFiles.text().as_bool();
+            }
+
+            // Pools
+            if (const auto xPools = xWks.child("Pools"))
+            {
+                for (const auto& xPool : xPools.children("Pool"))
+                {
+                    if (!ReadPool(pWks, xPool))
+                    {
+                        return false;
+                    }
                 }
-                for (const auto& def : config.Defines)
+            }
+
+            // Projects
+            const auto xProjects = xWks.children("Project");
+            pWks->Projects.reserve(std::distance(xProjects.begin(), xProjects.end()));
+            for (const auto& xProject : xProjects)
+            {
+                Project p = { .Wks = pWks };
+                if (!LoadProject(&p, xProject))
+                {
+                    return false;
+                }
+                
+                pWks->Projects.push_back(std::move(p));
+            }
+
+            return true;
+        }
+
+    public:
+        static bool LoadProject(Project* const pProject, const pugi::xml_node& xProject) noexcept
+        {
+            // Attributes (Name, Kind, Arch, Language, (C/Cpp)Version, Compiler, ...)
+            // const pugi::xml_node xProject = doc.first_child();
+            if (!ReadProjectAttributes(pProject, xProject))
+            {
+                return false;
+            }
+
+            // CWD
+            if (const auto xWorkingDirectory = xProject.child("WorkingDirectory"))
+            {
+                pProject->Wks->Cwd = xWorkingDirectory.child_value();
+            }
+            else
+            {
+                pProject->Wks->Cwd = "./";
+            }
+
+            // Output Directory
+            // if (const auto xOutputDir = xProject.child("OutputDir"))
+            // {
+            //     pProject->OutputDir = std::string{ xOutputDir.child_value() };
+            // }
+
+            // Project (Global) Defines
+            if (const auto xGlobalDefines = xProject.child("GlobalDefines"))
+            {
+                for (const auto& xItem : xGlobalDefines.children("Item"))
+                {
+                    pProject->Defines.push_back(xItem.child_value());
+                }
+            }
+
+            // Include, Source Directories
+            if (const auto xIncludeDirs = xProject.child("IncludeDirs"))
+            {
+                for (const auto& xItem : xIncludeDirs.children("Item"))
+                {
+                    pProject->IncludeDirs.push_back(xItem.child_value());
+                }
+            }
+            
+            if (const auto xSourceDirs = xProject.child("SourceDirs"))
+            {
+                for (const auto& xItem : xSourceDirs.children("Item"))
+                {
+                    pProject->SourceDirs.push_back(xItem.child_value());
+                }
+            }
+
+            // Library Directories & References (to libraries)
+            if (const auto xLibraryDirs = xProject.child("LibraryDirs"))
+            {
+                for (const auto& xItem : xLibraryDirs.children("Item"))
+                {
+                    pProject->LibraryDirs.push_back(xItem.child_value());
+                }
+            }
+            
+            if (const auto xReferences = xProject.child("References"))
+            {
+                for (const auto& xItem : xReferences.children("Item"))
+                {
+                    pProject->References.push_back(xItem.child_value());
+                }
+            }
+
+            // Configurations
+            for (const auto& xConfiguration : xProject.children("Configuration"))
+            {
+                if (!XmlReadHelper::ReadProjectConfiguration(pProject, xConfiguration))
+                {
+                    return false;
+                }
+            }
+
+            // Pools (<Pool>name</Pool> for all steps, or <Pool Kind="Link">name</Pool> for one kind of step)
+            for (const auto& xPool : xProject.children("Pool"))
+            {
+                const std::string_view poolName = xPool.child_value();
+                const auto& pools = pProject->Wks->Pools;
+                if (std::none_of(pools.begin(), pools.end(), [&poolName](const Pool& pool) { return pool.Name == poolName; }))
+                {
+                    printf("[ERROR]: Project `%.*s` uses undeclared pool `%.*s`\n", (int)pProject->Name.size(), pProject->Name.data(), (int)poolName.size(), poolName.data());
+                    return false;
+                }
+
+                if (const auto xAttr = xPool.attribute("Kind"))
+                {
+                    const CommandKind kind = Converter::StringToCommandKind(xAttr.as_string());
+                    if (kind == static_cast<CommandKind>(-1))
+                    {
+                        return false;
+                    }
+                    pProject->StepPools[kind] = poolName;
+                }
+                else
+                {
+                    pProject->Pool = poolName;
+                }
+            }
+
+            return true;
+        }
+
+        static bool ReadPool(Workspace* const pWks, const pugi::xml_node& xPool) noexcept
+        {
+            // <Pool Name="..." Depth="N"> (<Item>Compile|Link|Archive|Custom</Item> ...) </Pool>
+            Pool pool = {};
+            if (const auto xAttr = xPool.attribute("Name"))
+            {
+                pool.Name = xAttr.as_string();
+            }
+            else
+            {
+                return false;
+            }
+
+            pool.Depth = xPool.attribute("Depth").as_uint(1u);
+            if (pool.Depth == 0)
+            {
+                printf("[ERROR]: Pool `%.*s` must have a depth of at least 1\n", (int)pool.Name.size(), pool.Name.data());
+                return false;
+            }
+
+            for (const auto& xItem : xPool.children("Item"))
+            {
+                const CommandKind kind = Converter::StringToCommandKind(xItem.child_value());
+                if (kind == static_cast<CommandKind>(-1))
+                {
+                    return false;
+                }
+                pool.Kinds.push_back(kind);
+            }
+
+            pWks->Pools.push_back(std::move(pool));
+            return true;
+        }
+    
+        static bool ReadProjectAttributes(Project* const pProject, const pugi::xml_node& xProject) noexcept
+        {
+            bool bIsLanguageSet = false;
+            bool bIsLangVersionSet = false;
+            bool bIsCompilerSet = false;
+
+            if (const auto xAttr = xProject.attribute("Name")) { pProject->Name = xAttr.as_string(); }
+            if (const auto xAttr = xProject.attribute("Arch")) { pProject->Arch = xAttr.as_string(); }
+            if (const auto xAttr = xProject.attribute("Kind")) { pProject->OutputKind = Converter::StringToOutputKind(xAttr.as_string()); }
+            if (const auto xAttr = xProject.attribute("Language"))   { pProject->Language = xAttr.as_string(); bIsLanguageSet = true; }
+            if (const auto xAttr = xProject.attribute("CVersion"))   { pProject->CVersion = xAttr.as_string(); bIsLangVersionSet = true; }
+            if (const auto xAttr = xProject.attribute("CppVersion")) { pProject->CppVersion = xAttr.as_string(); bIsLangVersionSet = true; }
+            if (const auto xAttr = xProject.attribute("Compiler"))   { pProject->Compiler = xAttr.as_string(); bIsCompilerSet = true; }
+
+            if (pProject->Name.empty())
+            {
+                return false;
+            }
+
+            if (!bIsLanguageSet && !bIsLangVersionSet && !bIsCompilerSet)
+            {
+                return false;
+            }
+
+            if (!bIsCompilerSet)
+            {
+                pProject->Compiler = "g++";
+            }
+            
+            if (!bIsLanguageSet)
+            {
+                pProject->Language = pProject->Compiler == "gcc" ? "C" : "C++";
+            }
+
+            if (!bIsLangVersionSet)
+            {
+                pProject->CVersion = "89"; // C89
+                pProject->CppVersion = "14"; // C++14
+            }
+
+            return true;
+        }
+
+        static bool ReadProjectConfiguration(Project* const pProject, const pugi::xml_node& xConfiguration) noexcept
+        {
+            Configuration config = {};
+            // Name
+            if (const auto xAttr = xConfiguration.attribute("Name"))
+            {
+                config.Name = xAttr.as_string();
+            }
+            else
+            {
+                return false;
+            }
+            
+            // Flags (options)
+            if (const auto xFlags = xConfiguration.child("Flags"))
+            {
+                for (const auto& xItem : xFlags.children("Item"))
+                {
+                    config.Flags.push_back(xItem.child_value());
+                }
+            }
+            
+            // Configuration-dependent Defines (e.g DEBUG, NDEBUG, RELEASE, ASSERT, ...)
+            if (const auto xDefines = xConfiguration.child("Defines"))
+            {
+                for (const auto& xItem : xDefines.children("Item"))
+                {
+                    config.Defines.push_back(xItem.child_value());
+                }
+            }
+
+            // pProject->Configurations[config.Name] = config;
+            pProject->Configurations.insert({ config.Name, config });
+            return true;
+        }
+    };
+
+
+    // Binary image of a loaded workspace, kept next to its XML (as <file.xml>.cbuild_cache) so that
+    // an unchanged workspace is mapped in instead of parsed. Layout: Header, then the model as 32-bit
+    // words (counts, enums and string IDs, in `Transfer` order), then each distinct string once.
+    class WorkspaceSnapshot
+    {
+    public:
+        static inline constexpr const char* const Extension = ".cbuild_cache";
+        static inline constexpr uint32_t Magic = 0x534b5743; // "CWKS"
+        static inline constexpr uint32_t Version = 2; // Bump whenever the model (or `Transfer`) changes
+
+        // Identifies the XML the snapshot was taken from
+        struct XmlStamp
+        {
+            uint64_t Size = 0;
+            int64_t ModifiedTime = 0;
+            uint64_t Hash = 0; // Of the contents, only computed when needed
+            bool Hashed = false;
+        };
+
+        static bool GetXmlStamp(const char* lpXmlFilepath, XmlStamp* pStamp) noexcept
+        {
+            namespace stdfs = std::filesystem;
+
+            std::error_code ec = {};
+            pStamp->Size = stdfs::file_size(lpXmlFilepath, ec);
+            if (!ec)
+            {
+                pStamp->ModifiedTime = stdfs::last_write_time(lpXmlFilepath, ec).time_since_epoch().count();
+            }
+            return !ec;
+        }
+
+        static uint64_t Hash(const char* lpXmlFilepath, XmlStamp* pStamp) noexcept
+        {
+            if (!pStamp->Hashed)
+            {
+                Platform::MappedFile xml = {};
+                xml.Open(lpXmlFilepath);
+                Hash(xml, pStamp);
+            }
+            return pStamp->Hash;
+        }
+
+        static uint64_t Hash(const Platform::MappedFile& Xml, XmlStamp* pStamp) noexcept
+        {
+            Utils::Fnv1a hash = {};
+            hash.Add(Xml.GetData(), Xml.GetSize());
+            pStamp->Hash = hash.Value;
+            pStamp->Hashed = true;
+            return pStamp->Hash;
+        }
+
+        // Fails (leaving the workspace empty) unless the snapshot was taken from the XML as it is now.
+        // The workspace's strings point into the mapped snapshot, which it then owns.
+        static bool Load(Workspace* const pWks, const char* lpXmlFilepath, XmlStamp* pStamp) noexcept
+        {
+            const auto pFile = std::make_shared<Platform::MappedFile>();
+            const Platform::MappedFile& file = *pFile;
+            if (!pFile->Open(GetFilepath(lpXmlFilepath).c_str()) || file.GetSize() < sizeof(Header))
+            {
+                return false;
+            }
+
+            Header header = {};
+            memcpy(&header, file.GetData(), sizeof(header));
+            if (header.Magic != Magic || header.Version != Version || header.XmlSize != pStamp->Size)
+            {
+                return false;
+            }
+
+            // Touched (e.g. by a checkout) isn't necessarily changed
+            const bool bTouched = header.XmlModifiedTime != pStamp->ModifiedTime;
+            if (bTouched && Hash(lpXmlFilepath, pStamp) != header.XmlHash)
+            {
+                return false;
+            }
+
+            Reader reader = {};
+            if (!reader.Open(file, header) || !Transfer(reader, *pWks) || !reader.IsAtEnd())
+            {
+                *pWks = Workspace{};
+                return false;
+            }
+            for (Project& project : pWks->Projects)
+            {
+                project.Wks = pWks;
+            }
+            pWks->Storage = pFile;
+
+            if (bTouched)
+            {
+                Save(*pWks, lpXmlFilepath, *pStamp); // So that it isn't hashed again next time
+            }
+            return true;
+        }
+
+        // Makes equal strings of the model share their data, as they do in a workspace loaded from a snapshot
+        // (see `Utils::InternedEqual`). `Save` does it too, while it builds the snapshot's string table.
+        static void Intern(Workspace& Wks) noexcept
+        {
+            Writer writer = {};
+            Transfer(writer, Wks);
+        }
+
+        // Best effort, without a snapshot the XML is just parsed again next time. Interns the workspace.
+        static void Save(Workspace& Wks, const char* lpXmlFilepath, const XmlStamp& Stamp) noexcept
+        {
+            CBUILD_ASSERT(Stamp.Hashed, "The XML must be hashed before it is parsed");
+
+            Writer writer = {};
+            Transfer(writer, Wks);
+
+            const Header header =
+            {
+                .Magic = Magic,
+                .Version = Version,
+                .XmlSize = Stamp.Size,
+                .XmlModifiedTime = Stamp.ModifiedTime,
+                .XmlHash = Stamp.Hash,
+                .StringCount = (uint32_t)writer.Strings.size(),
+                .WordCount = (uint32_t)writer.Words.size(),
+            };
+
+            const std::string filepath = GetFilepath(lpXmlFilepath);
+            const std::string tmpFilepath = filepath + ".tmp";
+            FILE* pFile = fopen(tmpFilepath.c_str(), "wb");
+            if (!pFile)
+            {
+                return;
+            }
+
+            bool bWritten = fwrite(&header, sizeof(header), 1, pFile) == 1;
+            bWritten = bWritten && fwrite(writer.Words.data(), sizeof(uint32_t), writer.Words.size(), pFile) == writer.Words.size();
+            for (const std::string_view str : writer.Strings)
+            {
+                const uint32_t kLength = (uint32_t)str.size();
+                bWritten = bWritten && fwrite(&kLength, sizeof(kLength), 1, pFile) == 1;
+                bWritten = bWritten && (str.empty() || fwrite(str.data(), 1, str.size(), pFile) == str.size()); // May be null when empty
+            }
+            bWritten = (fclose(pFile) == 0) && bWritten;
+
+            std::error_code ec = {};
+            if (bWritten)
+            {
+                std::filesystem::rename(tmpFilepath, filepath, ec);
+            }
+            else
+            {
+                std::filesystem::remove(tmpFilepath, ec);
+            }
+        }
+
+    private:
+        struct Header
+        {
+            uint32_t Magic;
+            uint32_t Version;
+            uint64_t XmlSize;
+            int64_t XmlModifiedTime;
+            uint64_t XmlHash;
+            uint32_t StringCount;
+            uint32_t WordCount;
+        };
+
+        // Gives each distinct string an ID (its place in the string table) and interns the model as it goes:
+        // every view is pointed at the first one with its contents, so equal strings share their data
+        class Writer
+        {
+        public:
+            List<uint32_t> Words = {};
+            List<std::string_view> Strings = {}; // Into the workspace being saved
+
+            bool operator()(uint32_t Value) noexcept
+            {
+                Words.push_back(Value);
+                return true;
+            }
+
+            bool operator()(bool Value) noexcept
+            {
+                return (*this)((uint32_t)Value);
+            }
+
+            template<typename E> requires std::is_enum_v<E>
+            bool operator()(E Value) noexcept
+            {
+                return (*this)((uint32_t)Value);
+            }
+
+            bool operator()(std::string_view& Value) noexcept
+            {
+                const uint32_t kId = GetId(Value, false);
+                Value = Strings[kId];
+                return (*this)(kId);
+            }
+
+            bool operator()(std::string& Value) noexcept
+            {
+                return (*this)(GetId(Value, true));
+            }
+
+            template<typename T>
+            bool operator()(List<T>& Values) noexcept
+            {
+                (*this)((uint32_t)Values.size());
+                for (T& value : Values)
                 {
-                    cmd.Args.push_back("-D" + def);
+                    (*this)(value);
                 }
-                // Includes
-                for (const auto& inc : m_Project->IncludeDirs)
+                return true;
+            }
+
+            // Rebuilt, keys can't be repointed in place
+            template<typename K, typename V>
+            bool operator()(std::unordered_map<K, V>& Values) noexcept
+            {
+                (*this)((uint32_t)Values.size());
+                std::unordered_map<K, V> interned = {};
+                interned.reserve(Values.size());
+                for (auto& [key, value] : Values)
                 {
-                    cmd.Args.push_back("-I" + inc);
+                    K internedKey = key;
+                    (*this)(internedKey);
+                    (*this)(value);
+                    interned.emplace(internedKey, std::move(value));
                 }
-                // Library & References
-                for (const auto& libdir : m_Project->LibraryDirs)
+                Values.swap(interned);
+                return true;
+            }
+
+            template<typename T> requires std::is_class_v<T>
+            bool operator()(T& Value) noexcept
+            {
+                return Transfer(*this, Value);
+            }
+
+        private:
+            // Strings of commands (`std::string`s, which move with them) are written, but no view is pointed into them
+            uint32_t GetId(std::string_view Value, bool bOwned) noexcept
+            {
+                const auto [it, bInserted] = m_Ids.try_emplace(Value, (uint32_t)Strings.size());
+                if (bInserted)
                 {
-                    cmd.Args.push_back("-L" + libdir);
+                    Strings.push_back(Value);
+                    m_Owned.push_back(bOwned);
                 }
-                for (const auto& ref : m_Project->References)
+                else if (m_Owned[it->second] && !bOwned)
                 {
-                    cmd.Args.push_back("-l" + ref);
+                    Strings[it->second] = Value;
+                    m_Owned[it->second] = false;
                 }
-                // Options
-                if (m_Project->Arch.size() && m_Project->Arch == "x64")
+                return it->second;
+            }
+
+        private:
+            Map<std::string_view, uint32_t> m_Ids = {}; // By content
+            List<bool> m_Owned = {}; // By ID, whether the string is still one of a command's
+        };
+
+        // Every read is bounds checked, a damaged snapshot fails to load instead of crashing
+        class Reader
+        {
+        public:
+            bool Open(const Platform::MappedFile& File, const Header& header) noexcept
+            {
+                const uint8_t* pData = File.GetData() + sizeof(Header);
+                const uint8_t* const pEnd = File.GetData() + File.GetSize();
+                if ((size_t)(pEnd - pData) / sizeof(uint32_t) < header.WordCount)
                 {
-                    cmd.Args.push_back("-m64");
+                    return false;
                 }
-                if (m_Project->Language == "C++")
+                m_Words = pData;
+                m_WordCount = header.WordCount;
+                pData += m_WordCount * sizeof(uint32_t);
+
+                // Every string takes its length at least (before the count is trusted with an allocation)
+                if ((size_t)(pEnd - pData) / sizeof(uint32_t) < header.StringCount)
                 {
-                    cmd.Args.push_back("-std=c++" + m_Project->CppVersion);
+                    return false;
                 }
-                else
+                m_Strings.reserve(header.StringCount);
+                for (uint32_t kIndex = 0; kIndex < header.StringCount; kIndex++)
                 {
-                    cmd.Args.push_back("-std=c" + m_Project->CVersion);
+                    uint32_t kLength = 0;
+                    if ((size_t)(pEnd - pData) < sizeof(kLength))
+                    {
+                        return false;
+                    }
+                    memcpy(&kLength, pData, sizeof(kLength));
+                    pData += sizeof(kLength);
+
+                    if ((size_t)(pEnd - pData) < kLength)
+                    {
+                        return false;
+                    }
+                    m_Strings.emplace_back(reinterpret_cast<const char*>(pData), kLength);
+                    pData += kLength;
                 }
-                for (const auto& flag : config.Flags)
+                return pData == pEnd;
+            }
+
+            bool IsAtEnd() const noexcept
+            {
+                return m_Next == m_WordCount;
+            }
+
+            bool operator()(uint32_t& Value) noexcept
+            {
+                if (m_Next >= m_WordCount)
                 {
-                    cmd.Args.push_back("-" + flag);
+                    return false;
                 }
-                
-                return cmd;
-            };
+                memcpy(&Value, m_Words + m_Next * sizeof(uint32_t), sizeof(uint32_t));
+                m_Next++;
+                return true;
+            }
 
-            const auto PrepareFinalBuildCommand = [this, &outputDir, &outputFilename]() -> void
+            bool operator()(bool& Value) noexcept
             {
-                Command buildLibraryCmd = {};
-                if (m_Project->OutputKind == BuildOutputKind::StaticLibrary)
+                uint32_t kWord = 0;
+                const bool bRead = (*this)(kWord);
+                Value = kWord != 0;
+                return bRead;
+            }
+
+            template<typename E> requires std::is_enum_v<E>
+            bool operator()(E& Value) noexcept
+            {
+                uint32_t kWord = 0;
+                const bool bRead = (*this)(kWord);
+                Value = static_cast<E>(kWord);
+                return bRead;
+            }
+
+            bool operator()(std::string_view& Value) noexcept
+            {
+                uint32_t kId = 0;
+                if (!(*this)(kId) || kId >= m_Strings.size())
                 {
-                    buildLibraryCmd.Name = "ar";
-                    buildLibraryCmd.Args.push_back("-rcs");
+                    return false;
                 }
-                else
+                Value = m_Strings[kId];
+                return true;
+            }
+
+            bool operator()(std::string& Value) noexcept
+            {
+                std::string_view view = {};
+                const bool bRead = (*this)(view);
+                Value.assign(view);
+                return bRead;
+            }
+
+            template<typename T>
+            bool operator()(List<T>& Values) noexcept
+            {
+                uint32_t kCount = 0;
+                if (!(*this)(kCount) || kCount > m_WordCount - m_Next) // Every element takes a word at least
                 {
-                    buildLibraryCmd.Name = m_Project->Compiler;
-                    buildLibraryCmd.Args.push_back("-shared");
-                    buildLibraryCmd.Args.push_back(std::format("-Xlinker --out-implib {}\\{}.lib", outputDir, m_Project->Name));
+                    return false;
                 }
 
-                // Output
-                buildLibraryCmd.Args.push_back("-o");
-                buildLibraryCmd.Args.push_back(outputFilename);
-                // Intermediate Files
-                for (const auto& obj : m_OutputFiles)
+                Values.resize(kCount);
+                for (T& value : Values)
                 {
-                    buildLibraryCmd.Args.push_back(obj);
+                    if (!(*this)(value))
+                    {
+                        return false;
+                    }
                 }
-                
-                m_Commands.push_back(buildLibraryCmd);
-                m_OutputFiles.push_back(outputFilename);
-            };
+                return true;
+            }
 
-            const auto BuildApp = [this]() -> int32_t
+            template<typename K, typename V>
+            bool operator()(std::unordered_map<K, V>& Values) noexcept
             {
-                List<std::string> cmdLines;
-                cmdLines.reserve(m_Commands.size());
-
-                for (const auto& cmd : m_Commands)
+                uint32_t kCount = 0;
+                if (!(*this)(kCount) || kCount > m_WordCount - m_Next)
                 {
-                    std::ostringstream oss;
-                    oss << cmd.Name;
-                    for (const auto& arg : cmd.Args)
-                    {
-                        oss << " " << arg;
-                    }
-                    cmdLines.push_back(oss.str());
+                    return false;
                 }
 
-                BuildResult br = (BuildResult)0;
-                for (const auto& cmdline : cmdLines)
+                Values.reserve(kCount);
+                for (uint32_t kIndex = 0; kIndex < kCount; kIndex++)
                 {
-                    printf("%s\n", cmdline.c_str());
-                    if (system(cmdline.c_str()) != 0)
+                    K key = {};
+                    V value = {};
+                    if (!(*this)(key) || !(*this)(value))
                     {
-                        br = BuildResult::WksBuildFailed;
+                        return false;
                     }
+                    Values.emplace(std::move(key), std::move(value));
                 }
+                return true;
+            }
 
-                return br;
-            };
+            template<typename T> requires std::is_class_v<T>
+            bool operator()(T& Value) noexcept
+            {
+                return Transfer(*this, Value);
+            }
 
-            GenerateBuildCommandsAndOutputFiles(lpConfiguration, PrepareBaseCommand());
-            PrepareFinalBuildCommand();
+        private:
+            const uint8_t* m_Words = nullptr;
+            size_t m_WordCount = 0;
+            size_t m_Next = 0;
+            List<std::string_view> m_Strings = {}; // Into the mapped file
+        };
 
-            return BuildApp();
+        static std::string GetFilepath(const char* lpXmlFilepath) noexcept
+        {
+            return std::string{ lpXmlFilepath } + Extension;
         }
-    };
 
-}
+        // The one description of the layout, for both writing and reading
+        template<typename Archive>
+        static bool Transfer(Archive& ar, Workspace& Wks) noexcept
+        {
+            return ar(Wks.Name) && ar(Wks.Cwd) && ar(Wks.OutputDir) && ar(Wks.IntermediateDir)
+                && ar(Wks.Pools) && ar(Wks.Projects)
+                && ar(Wks.CheckOutputFilesBeforeBuild) && ar(Wks.DeleteOutputFilesIfBuildFails)
+                && ar(Wks.ExecutePreBuildCommands) && ar(Wks.ExecutePostBuildCommands);
+        }
 
+        template<typename Archive>
+        static bool Transfer(Archive& ar, Project& Proj) noexcept
+        {
+            return ar(Proj.Name) && ar(Proj.Arch) && ar(Proj.Language) && ar(Proj.CVersion) && ar(Proj.CppVersion) && ar(Proj.Compiler)
+                && ar(Proj.Defines) && ar(Proj.IncludeDirs) && ar(Proj.SourceDirs) && ar(Proj.LibraryDirs) && ar(Proj.References)
+                && ar(Proj.PreBuildCommands) && ar(Proj.PostBuildCommands) && ar(Proj.Configurations)
+                && ar(Proj.Pool) && ar(Proj.StepPools) && ar(Proj.OutputKind) && ar(Proj.InferCompilerFromExtensionsOrLanguage);
+        }
 
-namespace Cbuild
-{
+        template<typename Archive>
+        static bool Transfer(Archive& ar, Configuration& Config) noexcept
+        {
+            return ar(Config.Name) && ar(Config.Flags) && ar(Config.Defines);
+        }
 
-    static inline constexpr const char* GetVersion() noexcept
+        template<typename Archive>
+        static bool Transfer(Archive& ar, Pool& P) noexcept
+        {
+            return ar(P.Name) && ar(P.Depth) && ar(P.Kinds);
+        }
+
+        template<typename Archive>
+        static bool Transfer(Archive& ar, Command& Cmd) noexcept
+        {
+            // `Prefix` is left out, only planned commands share one
+            return ar(Cmd.Name) && ar(Cmd.Args) && ar(Cmd.Kind) && ar(Cmd.Input) && ar(Cmd.Output) && ar(Cmd.TempOutput) && ar(Cmd.Depfile);
+        }
+    };
+
+
+    Command::operator bool() const noexcept
     {
-        // X.X.X
-        return CBUILD_STR(CBUILD_VERSION_MAJOR) "."
-               CBUILD_STR(CBUILD_VERSION_MINOR) "."
-               CBUILD_STR(CBUILD_VERSION_BUILD);
+        return Name.length() > 0;
     }
 
+    size_t Command::GetArgCount() const noexcept
+    {
+        return (Prefix ? Prefix->size() : 0ull) + Args.size();
+    }
 
-    class Converter
+    
+    bool Workspace::Load(const char* lpXmlFilepath) noexcept
     {
-    public:
-        static const char* OutputKindToString(BuildOutputKind Kind) noexcept
+        WorkspaceSnapshot::XmlStamp stamp = {};
+        const bool bStamped = WorkspaceSnapshot::GetXmlStamp(lpXmlFilepath, &stamp);
+        if (bStamped && WorkspaceSnapshot::Load(this, lpXmlFilepath, &stamp))
         {
-            switch (Kind)
-            {
-                case BuildOutputKind::ConsoleApp:    return "ConsoleApp";
-                case BuildOutputKind::StaticLibrary: return "StaticLibrary";
-                case BuildOutputKind::SharedLibrary: return "SharedLibrary";
-                default: return CBUILD_ASSERT(false, 0), nullptr;
-            }
+            return true;
         }
 
-        static BuildOutputKind StringToOutputKind(const std::string_view& Value) noexcept
+        // Parsed in place, the model points into the (privately) mapped XML. Copying each distinct string
+        // out of it costs more than the parse; the snapshot written next stores each of them once, and
+        // that is what later loads use.
+        const auto pXml = std::make_shared<Platform::MappedFile>();
+        if (!pXml->Open(lpXmlFilepath, true))
         {
-            if (Value == "ConsoleApp")    return BuildOutputKind::ConsoleApp;
-            if (Value == "StaticLibrary") return BuildOutputKind::StaticLibrary;
-            if (Value == "SharedLibrary") return BuildOutputKind::SharedLibrary;
-            
-            return static_cast<BuildOutputKind>(-1);
+            printf("[ERROR]: Failed to open `%s`\n", lpXmlFilepath);
+            return false;
         }
-    };
-
+        WorkspaceSnapshot::Hash(*pXml, &stamp); // Before it is parsed (which writes to it)
 
-    class XmlReadHelper
-    {
-    public:
-        static bool LoadWorkspace(Workspace* const pWks, const char* lpXmlFilepath) noexcept
+        if (!XmlReadHelper::LoadWorkspace(this, lpXmlFilepath, pXml->GetData(), pXml->GetSize()))
         {
-            CBUILD_ASSERT(lpXmlFilepath, "Invalid filepath");
+            return false;
+        }
+        Storage = pXml;
 
-            pugi::xml_document doc;
-            pugi::xml_parse_result res = doc.load_file(lpXmlFilepath, pugi::parse_full);
-            CBUILD_ASSERT((bool)res, "Error in parsing `%s`. Description=%s, FileOffset=%I64d", lpXmlFilepath, res.description(), res.offset);
+        if (bStamped)
+        {
+            WorkspaceSnapshot::Save(*this, lpXmlFilepath, stamp);
+        }
+        else
+        {
+            WorkspaceSnapshot::Intern(*this);
+        }
+        return true;
+    }
+    
+    bool Workspace::CheckOutputFiles() noexcept
+    {
+        CBUILD_ASSERT(false, "Unimplemented");
+        return false;
+    }
 
-            const pugi::xml_node xWks = doc.first_child();
+    bool Workspace::DeleteOutputFiles() noexcept
+    {
+        CBUILD_ASSERT(false, "Unimplemented");
+        return false;
+    }
 
-            // Attributes
-            if (const auto xAttr = xWks.attribute("Name"))
-            {
-                pWks->Name = std::string{ xAttr.as_string() };
-            }
-            else
-            {
-                return false;
-            }
-            
-            // Output Directory
-            if (const auto xOutputDir = xWks.child("OutputDir"))
-            {
-                pWks->OutputDir = std::string{ xOutputDir.child_value() };
-            }
-            else
+    // Project's pool for the step kind, then the project's pool, then the workspace's pool for the step kind
+    static int32_t FindPool(const Workspace& Wks, const Project& p, CommandKind Kind) noexcept
+    {
+        const auto it = p.StepPools.find(Kind);
+        const std::string_view name = it != p.StepPools.end() ? it->second : p.Pool;
+        for (size_t kIndex = 0; kIndex < Wks.Pools.size(); kIndex++)
+        {
+            const Pool& pool = Wks.Pools[kIndex];
+            const bool bMatches = name.empty()
+                ? std::find(pool.Kinds.begin(), pool.Kinds.end(), Kind) != pool.Kinds.end()
+                : pool.Name == name;
+            if (bMatches)
             {
-                pWks->OutputDir = std::string{ "bin" };
+                return (int32_t)kIndex;
             }
-            
-            // Intermediates Directory
-            if (const auto xIntermediateDir = xWks.child("IntermediateDir"))
+        }
+        return -1;
+    }
+
+    // What a build is limited to by its targets. A project is built whole when it is a target (or its output
+    // is), and so is everything it references; a project that only builds target files (an object, or the
+    // source it is compiled from) just compiles those. The rest of the projects aren't even planned.
+    struct TargetSelection
+    {
+        enum class Scope : uint8_t
+        {
+            None = 0,
+            Files,
+            Whole,
+        };
+
+        List<Scope> Projects = {}; // By project
+        std::unordered_set<std::string> Files = {}; // Normal filepaths
+
+        // Without targets, everything
+        bool Select(const Workspace& Wks, const char* lpConfiguration, const List<const char*>& Targets) noexcept
+        {
+            namespace stdfs = std::filesystem;
+
+            Projects.assign(Wks.Projects.size(), Targets.empty() ? Scope::Whole : Scope::None);
+            for (const char* lpTarget : Targets)
             {
-                pWks->IntermediateDir = std::string{ xIntermediateDir.child_value() };
+                const std::string_view target{ lpTarget };
+                const std::string file = Utils::MakeNormalFilepath(lpTarget);
+                const stdfs::path path{ file };
+                const std::string parent = path.parent_path().string();
+                const std::string stem = path.stem().string();
+                const std::string ext = path.extension().string();
+                const std::string intermediateDir = Utils::MakeNormalFilepath(std::format("{}" CBUILD_PATH_SEP "{}", Wks.IntermediateDir, lpConfiguration));
+
+                bool bFound = false;
+                for (size_t kProject = 0; kProject < Wks.Projects.size(); kProject++)
+                {
+                    const Project& p = Wks.Projects[kProject];
+                    if (p.Name == target || file == Utils::MakeNormalFilepath(Builders::MakeOutputFilepath(p, lpConfiguration)))
+                    {
+                        Projects[kProject] = Scope::Whole;
+                        bFound = true;
+                        continue;
+                    }
+
+                    // One of its sources, or the object of one
+                    for (const auto& srcdir : p.SourceDirs)
+                    {
+                        const stdfs::path dir = stdfs::path(Wks.Cwd) / srcdir;
+                        std::error_code ec = {};
+                        const bool bSource = (ext == ".c" || ext == ".cpp") && parent == Utils::MakeNormalFilepath(dir.string());
+                        const bool bObject = ext == ".o" && parent == intermediateDir
+                            && (stdfs::is_regular_file(dir / (stem + ".cpp"), ec) || stdfs::is_regular_file(dir / (stem + ".c"), ec));
+                        if (bSource || bObject)
+                        {
+                            Projects[kProject] = std::max(Projects[kProject], Scope::Files);
+                            Files.insert(file);
+                            bFound = true;
+                            break;
+                        }
+                    }
+                }
+
+                if (!bFound)
+                {
+                    printf("[ERROR]: Target `%s` is neither a project nor a file that one of them builds\n", lpTarget);
+                    return false;
+                }
             }
-            else
+
+            // The projects that whole projects reference are needed whole too
+            List<size_t> stack = {};
+            for (size_t kProject = 0; kProject < Projects.size(); kProject++)
             {
-                pWks->IntermediateDir = std::string{ "bin-int" };
+                if (Projects[kProject] == Scope::Whole)
+                {
+                    stack.push_back(kProject);
+                }
             }
-            
-            // Projects
-            for (const auto& xProject : xWks.children("Project"))
+            while (!stack.empty())
             {
-                Project p = { .Wks = pWks };
-                if (!LoadProject(&p, xProject))
+                const Project& p = Wks.Projects[stack.back()];
+                stack.pop_back();
+                for (const auto& ref : p.References)
                 {
-                    return false;
+                    for (size_t kProject = 0; kProject < Wks.Projects.size(); kProject++)
+                    {
+                        if (Wks.Projects[kProject].Name == ref && Projects[kProject] != Scope::Whole)
+                        {
+                            Projects[kProject] = Scope::Whole;
+                            stack.push_back(kProject);
+                        }
+                    }
                 }
-                
-                pWks->Projects.push_back(std::move(p));
             }
-
             return true;
         }
 
-    public:
-        static bool LoadProject(Project* const pProject, const pugi::xml_node& xProject) noexcept
+        bool Wants(size_t Project, const Command& Cmd) const noexcept
         {
-            // Attributes (Name, Kind, Arch, Language, (C/Cpp)Version, Compiler, ...)
-            // const pugi::xml_node xProject = doc.first_child();
-            if (!ReadProjectAttributes(pProject, xProject))
+            return Projects[Project] == Scope::Whole || (Projects[Project] == Scope::Files && Cmd.Kind == CommandKind::Compile
+                && (Files.contains(Utils::MakeNormalFilepath(Cmd.Output)) || Files.contains(Utils::MakeNormalFilepath(Cmd.Input))));
+        }
+    };
+
+    // The compile, but only parsed (-fsyntax-only). Nothing is written but the depfile, which is its output: a stamp
+    // of when the source last parsed, that tells `--check` what it can skip.
+    static Command MakeSyntaxCheckCommand(const Command& Compile) noexcept
+    {
+        Command cmd = { .Name = Compile.Name, .Prefix = Compile.Prefix, .Kind = CommandKind::Compile, .Input = Compile.Input, .Output = Compile.Output + ".check.d" };
+        cmd.TempOutput = Utils::MakeTemporaryFilepath(cmd.Output);
+        cmd.Depfile = cmd.Output;
+        cmd.Args = { "-fsyntax-only", Compile.Input, "-MF", cmd.TempOutput };
+        return cmd;
+    }
+
+    // Creates a builder per project and plans the selected ones in parallel (walking their source directories).
+    // Returns the first project's error, if any. `OnCompile` also gets every compile (from a planning thread) once
+    // it is found.
+    static int32_t PlanProjects(const Workspace& Wks, const char* lpConfiguration, const TargetSelection& Selection, List<std::unique_ptr<IProjectBuilder>>& Builders,
+        const std::function<void(uint32_t Project, const Command&)>& OnCompile = {}) noexcept
+    {
+        List<int32_t> results(Wks.Projects.size(), EXIT_SUCCESS);
+        for (const auto& p : Wks.Projects)
+        {
+            IProjectBuilder* pBuilder = IProjectBuilder::Create(p.OutputKind, &p);
+            CBUILD_ASSERT(pBuilder != nullptr, "failed to allocate memory");
+            if (OnCompile)
             {
-                return false;
+                pBuilder->SetCompileSink([&OnCompile, kProject = (uint32_t)Builders.size()](const Command& Cmd) { OnCompile(kProject, Cmd); });
             }
-
-            // CWD
-            if (const auto xWorkingDirectory = xProject.child("WorkingDirectory"))
+            Builders.emplace_back(pBuilder);
+        }
+        Tasks::ParallelFor(Builders.size(), 1ull, [&](size_t Begin, size_t End)
+        {
+            for (size_t kIndex = Begin; kIndex < End; kIndex++)
             {
-                pProject->Wks->Cwd = std::string{ xWorkingDirectory.child_value() };
+                if (Selection.Projects[kIndex] != TargetSelection::Scope::None)
+                {
+                    results[kIndex] = Builders[kIndex]->Plan(lpConfiguration);
+                }
             }
-            else
+        });
+
+        for (const int32_t kResult : results)
+        {
+            if (kResult != EXIT_SUCCESS)
             {
-                pProject->Wks->Cwd = std::string{ "./" };
+                return kResult;
             }
+        }
+        return 0;
+    }
 
-            // Output Directory
-            // if (const auto xOutputDir = xProject.child("OutputDir"))
-            // {
-            //     pProject->OutputDir = std::string{ xOutputDir.child_value() };
-            // }
+    // Adds the selected jobs of the planned projects to `Graph` (in order): a project's final step comes after its
+    // compiles, and after the final steps of the (workspace) projects it references. The commands belong to
+    // `Builders`, except for compiles that were streamed in from `pFeed`, which are in the graph already.
+    static void AddPlannedJobs(const Workspace& Wks, const TargetSelection& Selection, const List<std::unique_ptr<IProjectBuilder>>& Builders, const Exec::CompileFeed* pFeed, Exec::JobGraph& Graph) noexcept
+    {
+        std::unordered_map<std::string_view, uint32_t, Utils::InternedHash, Utils::InternedEqual> finalJobs = {}; // Project name -> job producing the project's output
 
-            // Project (Global) Defines
-            if (const auto xGlobalDefines = xProject.child("GlobalDefines"))
+        for (size_t kProject = 0; kProject < Wks.Projects.size(); kProject++)
+        {
+            const Project& p = Wks.Projects[kProject];
+            const List<Command>& cmds = Builders[kProject]->GetBuildCommands();
+            List<uint32_t> compileJobs = pFeed ? pFeed->GetGroup((uint32_t)kProject) : List<uint32_t>{};
+            for (size_t kIndex = 0; !pFeed && kIndex + 1ull < cmds.size(); kIndex++)
             {
-                for (const auto& xItem : xGlobalDefines.children("Item"))
+                if (Selection.Wants(kProject, cmds[kIndex]))
                 {
-                    pProject->Defines.push_back(std::string{ xItem.child_value() });
+                    compileJobs.push_back(Graph.Add(&cmds[kIndex], FindPool(Wks, p, cmds[kIndex].Kind)));
                 }
             }
-
-            // Include, Source Directories
-            if (const auto xIncludeDirs = xProject.child("IncludeDirs"))
+            if (Selection.Projects[kProject] != TargetSelection::Scope::Whole)
             {
-                for (const auto& xItem : xIncludeDirs.children("Item"))
-                {
-                    pProject->IncludeDirs.push_back(std::string{ xItem.child_value() });
-                }
+                continue;
             }
-            
-            if (const auto xSourceDirs = xProject.child("SourceDirs"))
+
+            const uint32_t kFinalJob = Graph.Add(&cmds.back(), FindPool(Wks, p, cmds.back().Kind));
+            for (const uint32_t kJob : compileJobs)
             {
-                for (const auto& xItem : xSourceDirs.children("Item"))
-                {
-                    pProject->SourceDirs.push_back(std::string{ xItem.child_value() });
-                }
+                Graph.AddEdge(kJob, kFinalJob);
             }
+            finalJobs[p.Name] = kFinalJob;
+        }
 
-            // Library Directories & References (to libraries)
-            if (const auto xLibraryDirs = xProject.child("LibraryDirs"))
+        // Projects are linked after the (workspace) projects they reference
+        for (const auto& p : Wks.Projects)
+        {
+            for (const auto& ref : p.References)
             {
-                for (const auto& xItem : xLibraryDirs.children("Item"))
+                const auto it = finalJobs.find(ref);
+                if (it != finalJobs.end() && !Utils::InternedEqual{}(ref, p.Name) && finalJobs.contains(p.Name))
                 {
-                    pProject->LibraryDirs.push_back(std::string{ xItem.child_value() });
+                    Graph.AddEdge(it->second, finalJobs[p.Name]);
                 }
             }
-            
-            if (const auto xReferences = xProject.child("References"))
+        }
+
+        Graph.Finalize();
+    }
+
+    // Plans every project into `Graph`, before anything runs
+    static int32_t PlanWorkspace(const Workspace& Wks, const char* lpConfiguration, List<std::unique_ptr<IProjectBuilder>>& Builders, Exec::JobGraph& Graph) noexcept
+    {
+        for (const Pool& pool : Wks.Pools)
+        {
+            Graph.AddPool(pool.Depth);
+        }
+        TargetSelection all = {};
+        all.Select(Wks, lpConfiguration, {});
+        if (const int32_t result = PlanProjects(Wks, lpConfiguration, all, Builders); result != EXIT_SUCCESS)
+        {
+            return result;
+        }
+        AddPlannedJobs(Wks, all, Builders, nullptr, Graph);
+        return 0;
+    }
+
+    // The projects are planned on another thread, which streams their compiles to the executor: a compile can start
+    // as soon as its source is found and it turns out to be dirty. The links and archives (which need every object of
+    // their project) join in once planning is done, along with the checks that need the whole graph. With targets,
+    // the projects they don't need are left alone.
+    int32_t Workspace::Build(const char* lpConfiguration, const ExecutionOptions& Options, const List<const char*>& Targets) const noexcept
+    {
+        TargetSelection selection = {};
+        if (!selection.Select(*this, lpConfiguration, Targets))
+        {
+            return BuildResult::CommandProcessFailed;
+        }
+
+        Exec::BuildDatabase db = {};
+        if (!db.Load(std::format("{}" CBUILD_PATH_SEP "{}", IntermediateDir, Exec::BuildDatabase::Filename)))
+        {
+            db.Save(); // Start a new one, for the journal to append to
+        }
+
+        List<std::unique_ptr<IProjectBuilder>> builders = {};
+        Exec::JobGraph graph = {};
+        Exec::CompileFeed feed = {};
+        for (const Pool& pool : Pools)
+        {
+            graph.AddPool(pool.Depth);
+        }
+
+        int32_t iPlanResult = 0;
+        // Inherits main's signal mask, so an interrupt while planning still reaches the executor's signalfd
+        std::thread planner([&]() -> void
+        {
+#if defined(CBUILD_LINUX)
+            CBUILD_ASSERT(Platform::AreInterruptSignalsBlocked(), "The planner was started before main blocked the interrupt signals");
+#endif // CBUILD_LINUX
+            iPlanResult = PlanProjects(*this, lpConfiguration, selection, builders, [&](uint32_t kProject, const Command& cmd)
             {
-                for (const auto& xItem : xReferences.children("Item"))
+                if (selection.Wants(kProject, cmd))
                 {
-                    pProject->References.push_back(std::string{ xItem.child_value() });
+                    feed.Push(kProject, cmd, FindPool(*this, Projects[kProject], cmd.Kind));
                 }
+            });
+            feed.Close();
+        });
+
+        const auto OnPlanned = [&]() -> int32_t
+        {
+            planner.join();
+            if (iPlanResult != EXIT_SUCCESS)
+            {
+                return iPlanResult;
             }
 
-            // Configurations
-            for (const auto& xConfiguration : xProject.children("Configuration"))
+            AddPlannedJobs(*this, selection, builders, &feed, graph);
+            graph.Estimate(db);
+            if (!graph.Sort())
             {
-                if (!XmlReadHelper::ReadProjectConfiguration(pProject, xConfiguration))
+                printf("[ERROR]: Projects in workspace `%.*s` have cyclic references\n", (int)Name.size(), Name.data());
+                return BuildResult::CommandProcessFailed;
+            }
+            const size_t kDirty = graph.MarkDirty(db);
+            graph.ComputeCriticalPaths();
+            size_t kScanReads = 0;
+            const size_t kScanned = Exec::ScanUnbuiltSources(graph, db, &kScanReads);
+            if (Options.Verbose)
+            {
+                printf("%zu of %zu jobs to run (%zu files checked)\n", kDirty, graph.GetJobs().GetCount(), graph.GetStatCount());
+                if (kScanned)
                 {
-                    return false;
+                    printf("Scanned the includes of %zu new sources (%zu files read)\n", kScanned, kScanReads);
                 }
             }
+            return 0;
+        };
 
-            return true;
+        ExecutionOptions options = Options;
+        options.DeleteFailedOutputs = DeleteOutputFilesIfBuildFails;
+
+        const int32_t result = Exec::Executor{ graph, db, options }.Run(feed, OnPlanned);
+        if (planner.joinable())
+        {
+            planner.join(); // Stopped before planning was done
         }
-    
-        static bool ReadProjectAttributes(Project* const pProject, const pugi::xml_node& xProject) noexcept
+        db.Save();
+
+        return result;
+    }
+
+    // Parses every source that changed since it last compiled or parsed, without writing objects or linking: a
+    // quick look at whether everything still compiles. A source is skipped if its object is up to date (it compiled)
+    // or its check stamp is (it parsed, see `MakeSyntaxCheckCommand`), which is what the two passes find out.
+    int32_t Workspace::Check(const char* lpConfiguration, const ExecutionOptions& Options, const List<const char*>& Targets) const noexcept
+    {
+        TargetSelection selection = {};
+        if (!selection.Select(*this, lpConfiguration, Targets))
         {
-            bool bIsLanguageSet = false;
-            bool bIsLangVersionSet = false;
-            bool bIsCompilerSet = false;
+            return BuildResult::CommandProcessFailed;
+        }
+        List<std::unique_ptr<IProjectBuilder>> builders = {};
+        if (const int32_t result = PlanProjects(*this, lpConfiguration, selection, builders); result != EXIT_SUCCESS)
+        {
+            return result;
+        }
 
-            if (const auto xAttr = xProject.attribute("Name")) { pProject->Name = std::string{ xAttr.as_string() }; }
-            if (const auto xAttr = xProject.attribute("Arch")) { pProject->Arch = std::string{ xAttr.as_string() }; }
-            if (const auto xAttr = xProject.attribute("Kind")) { pProject->OutputKind = Converter::StringToOutputKind(xAttr.as_string()); }
-            if (const auto xAttr = xProject.attribute("Language"))   { pProject->Language = std::string{ xAttr.as_string() }; bIsLanguageSet = true; }
-            if (const auto xAttr = xProject.attribute("CVersion"))   { pProject->CVersion = std::string{ xAttr.as_string() }; bIsLangVersionSet = true; }
-            if (const auto xAttr = xProject.attribute("CppVersion")) { pProject->CppVersion = std::string{ xAttr.as_string() }; bIsLangVersionSet = true; }
-            if (const auto xAttr = xProject.attribute("Compiler"))   { pProject->Compiler = std::string{ xAttr.as_string() }; bIsCompilerSet = true; }
+        Exec::BuildDatabase db = {};
+        if (!db.Load(std::format("{}" CBUILD_PATH_SEP "{}", IntermediateDir, Exec::BuildDatabase::Filename)))
+        {
+            db.Save(); // Start a new one, for the journal to append to
+        }
 
-            if (pProject->Name.empty())
+        // The compiles whose objects are out of date
+        Exec::JobGraph compiles = {};
+        List<size_t> projects = {};
+        for (size_t kProject = 0; kProject < Projects.size(); kProject++)
+        {
+            const List<Command>& cmds = builders[kProject]->GetBuildCommands();
+            for (size_t kIndex = 0; kIndex + 1ull < cmds.size(); kIndex++)
             {
-                return false;
+                if (selection.Wants(kProject, cmds[kIndex]))
+                {
+                    compiles.Add(&cmds[kIndex]);
+                    projects.push_back(kProject);
+                }
             }
+        }
+        compiles.Finalize();
+        compiles.Sort();
+        compiles.MarkDirty(db);
 
-            if (!bIsLanguageSet && !bIsLangVersionSet && !bIsCompilerSet)
+        // Of those, the ones that weren't checked since
+        const Exec::JobTable& compileJobs = compiles.GetJobs();
+        List<Command> cmds = {};
+        cmds.reserve(compileJobs.GetCount()); // The graph points into it
+        Exec::JobGraph graph = {};
+        for (const Pool& pool : Pools)
+        {
+            graph.AddPool(pool.Depth);
+        }
+        for (uint32_t kIndex = 0; kIndex < compileJobs.GetCount(); kIndex++)
+        {
+            if (compileJobs.State[kIndex] == Exec::JobState::Dirty)
             {
-                return false;
+                cmds.push_back(MakeSyntaxCheckCommand(*compileJobs.Cmd[kIndex]));
+                graph.Add(&cmds.back(), FindPool(*this, Projects[projects[kIndex]], CommandKind::Compile));
             }
+        }
+        graph.Finalize();
+        graph.Estimate(db);
+        graph.Sort();
+        const size_t kDirty = graph.MarkDirty(db);
+        graph.ComputeCriticalPaths();
+        if (Options.Verbose)
+        {
+            printf("%zu of %zu sources to check (%zu files checked)\n", kDirty, compileJobs.GetCount(), compiles.GetStatCount() + graph.GetStatCount());
+        }
 
-            if (!bIsCompilerSet)
-            {
-                pProject->Compiler = "g++";
-            }
-            
-            if (!bIsLanguageSet)
-            {
-                pProject->Language = pProject->Compiler == "gcc" ? "C" : "C++";
-            }
+        const int32_t result = Exec::Executor{ graph, db, Options }.Run();
+        db.Save();
 
-            if (!bIsLangVersionSet)
-            {
-                pProject->CVersion = "89"; // C89
-                pProject->CppVersion = "14"; // C++14
-            }
+        return result;
+    }
 
-            return true;
+    // Compiles the source as a build would (its project is planned for that file alone, without walking any
+    // directory), up to date or not: for editors, on save. With `bSyntaxOnly` it is only parsed, like `--check` does.
+    int32_t Workspace::CompileFile(const char* lpConfiguration, const ExecutionOptions& Options, const char* lpFilepath, bool bSyntaxOnly) const noexcept
+    {
+        const std::string ext = std::filesystem::path{ lpFilepath }.extension().string();
+        if (ext != ".c" && ext != ".cpp")
+        {
+            printf("[ERROR]: `%s` is not a C or C++ source\n", lpFilepath);
+            return BuildResult::CommandProcessFailed;
+        }
+        TargetSelection selection = {};
+        if (!selection.Select(*this, lpConfiguration, { lpFilepath }))
+        {
+            return BuildResult::CommandProcessFailed;
         }
 
-        static bool ReadProjectConfiguration(Project* const pProject, const pugi::xml_node& xConfiguration) noexcept
+        const size_t kProject = (size_t)(std::find(selection.Projects.begin(), selection.Projects.end(), TargetSelection::Scope::Files) - selection.Projects.begin());
+        const Project& p = Projects[kProject];
+        const std::unique_ptr<IProjectBuilder> pBuilder{ IProjectBuilder::Create(p.OutputKind, &p) };
+        CBUILD_ASSERT(pBuilder != nullptr, "failed to allocate memory");
+        pBuilder->SetSourceFilter(Utils::MakeNormalFilepath(lpFilepath));
+        if (const int32_t result = pBuilder->Plan(lpConfiguration); result != EXIT_SUCCESS)
         {
-            Configuration config = {};
-            // Name
-            if (const auto xAttr = xConfiguration.attribute("Name"))
+            return result;
+        }
+        const List<Command>& cmds = pBuilder->GetBuildCommands();
+        if (cmds.size() < 2ull)
+        {
+            printf("[ERROR]: `%s` was not found\n", lpFilepath);
+            return BuildResult::CommandProcessFailed;
+        }
+        const Command cmd = bSyntaxOnly ? MakeSyntaxCheckCommand(cmds.front()) : cmds.front();
+
+        Exec::BuildDatabase db = {};
+        if (!db.Load(std::format("{}" CBUILD_PATH_SEP "{}", IntermediateDir, Exec::BuildDatabase::Filename)))
+        {
+            db.Save();
+        }
+
+        Exec::JobGraph graph = {};
+        graph.Add(&cmd, FindPool(*this, p, cmd.Kind));
+        graph.Finalize();
+        graph.Estimate(db);
+        graph.Sort();
+        graph.ComputeCriticalPaths();
+
+        ExecutionOptions options = Options;
+        options.DeleteFailedOutputs = DeleteOutputFilesIfBuildFails;
+
+        // The journal has its record, rewriting the whole database isn't worth it for one file
+        return Exec::Executor{ graph, db, options }.Run();
+    }
+
+    int32_t Workspace::QueryReverseDependencies(const char* lpConfiguration, const List<const char*>& Filepaths) const noexcept
+    {
+        List<std::unique_ptr<IProjectBuilder>> builders = {};
+        Exec::JobGraph graph = {};
+        if (const int32_t result = PlanWorkspace(*this, lpConfiguration, builders, graph); result != EXIT_SUCCESS)
+        {
+            return result;
+        }
+
+        // Headers are known from the depfiles of previous builds, or else from a scan (which isn't kept, the database is only read)
+        Exec::BuildDatabase db = {};
+        db.Load(std::format("{}" CBUILD_PATH_SEP "{}", IntermediateDir, Exec::BuildDatabase::Filename));
+        Exec::ScanUnbuiltSources(graph, db);
+
+        const Exec::JobTable& jobs = graph.GetJobs();
+        List<uint8_t> affected(jobs.GetCount(), 0);
+        List<uint32_t> stack = {};
+        const auto Affect = [&](uint32_t Index) -> void
+        {
+            if (!affected[Index])
             {
-                config.Name = std::string{ xAttr.as_string() };
+                affected[Index] = 1;
+                stack.push_back(Index);
             }
-            else
+        };
+
+        std::unordered_set<std::string> files = {};
+        for (const char* lpFilepath : Filepaths)
+        {
+            files.insert(Utils::MakeNormalFilepath(lpFilepath));
+        }
+
+        // Jobs that read one of the files: as their source, as the output of a dependency, or as a header
+        Dictionary<uint32_t> producers = {}; // Output -> job
+        for (uint32_t kIndex = 0; kIndex < jobs.GetCount(); kIndex++)
+        {
+            const Command& cmd = *jobs.Cmd[kIndex];
+            producers[cmd.Output] = kIndex;
+            if (!cmd.Input.empty() && files.contains(Utils::MakeNormalFilepath(cmd.Input)))
             {
-                return false;
+                Affect(kIndex);
             }
-            
-            // Flags (options)
-            if (const auto xFlags = xConfiguration.child("Flags"))
+            if (files.contains(Utils::MakeNormalFilepath(cmd.Output)))
             {
-                for (const auto& xItem : xFlags.children("Item"))
+                for (const uint32_t kDependent : graph.GetDependents(kIndex))
                 {
-                    config.Flags.push_back(std::string{ xItem.child_value() });
+                    Affect(kDependent);
                 }
             }
-            
-            // Configuration-dependent Defines (e.g DEBUG, NDEBUG, RELEASE, ASSERT, ...)
-            if (const auto xDefines = xConfiguration.child("Defines"))
+        }
+        for (const std::string& file : files)
+        {
+            if (const List<const std::string*>* pIncluders = db.FindIncluders(file))
             {
-                for (const auto& xItem : xDefines.children("Item"))
+                for (const std::string* pOutput : *pIncluders)
                 {
-                    config.Defines.push_back(std::string{ xItem.child_value() });
+                    // The database also knows nodes of other configurations, and of sources that are gone
+                    if (const auto it = producers.find(*pOutput); it != producers.end())
+                    {
+                        Affect(it->second);
+                    }
                 }
             }
+        }
 
-            // pProject->Configurations[config.Name] = config;
-            pProject->Configurations.insert({ config.Name, config });
-            return true;
+        // And everything downstream of them
+        while (!stack.empty())
+        {
+            const uint32_t kIndex = stack.back();
+            stack.pop_back();
+            for (const uint32_t kDependent : graph.GetDependents(kIndex))
+            {
+                Affect(kDependent);
+            }
         }
-    };
 
+        // Objects first, then the outputs built from them
+        size_t kAffected = 0;
+        for (const bool bObjects : { true, false })
+        {
+            for (uint32_t kIndex = 0; kIndex < jobs.GetCount(); kIndex++)
+            {
+                if (affected[kIndex] && (jobs.Kind[kIndex] == CommandKind::Compile) == bObjects)
+                {
+                    printf("%s\n", jobs.Cmd[kIndex]->Output.c_str());
+                    kAffected++;
+                }
+            }
+        }
+        if (!kAffected)
+        {
+            fprintf(stderr, "[WARNING]: Nothing reads the given files (as far as the last build knows)\n");
+        }
 
-    Command::operator bool() const noexcept
-    {
-        return Name.length() > 0;
+        return 0;
     }
 
     
-    bool Workspace::Load(const char* lpXmlFilepath) noexcept
-    {
-        return XmlReadHelper::LoadWorkspace(this, lpXmlFilepath);
-    }
-    
-    bool Workspace::CheckOutputFiles() noexcept
-    {
-        CBUILD_ASSERT(false, "Unimplemented");
-        return false;
-    }
-
-    bool Workspace::DeleteOutputFiles() noexcept
+    void IProjectBuilder::SetCompileSink(std::function<void(const Command&)> Sink) noexcept
     {
-        CBUILD_ASSERT(false, "Unimplemented");
-        return false;
+        m_CompileSink = std::move(Sink);
     }
 
-    int32_t Workspace::Build(const char* lpConfiguration) const noexcept
+    void IProjectBuilder::SetSourceFilter(std::string Filepath) noexcept
     {
-        int32_t result = EXIT_SUCCESS;
-        for (const auto p : Projects)
-        {
-            IProjectBuilder* pBuilder = IProjectBuilder::Create(p.OutputKind, &p);
-            printf("=========== Building `%s` ===========\n", p.Name.c_str());
-            CBUILD_ASSERT(pBuilder != nullptr, "failed to allocate memory");
-            result = pBuilder->Build(lpConfiguration);
-            printf("\n");
-        }
-
-        return result;
+        m_SourceFilter = std::move(Filepath);
     }
 
-    
     const List<Command>& IProjectBuilder::GetBuildCommands() const noexcept
     {
         return m_Commands;
@@ -751,14 +6025,60 @@ namespace Cbuild
 
         const stdfs::path cwd = stdfs::path(m_Project->Wks->Cwd);
         const std::string ConfigName{ lpConfiguration }; 
-        const std::string IntermediateDir = std::format("{}\\{}", m_Project->Wks->IntermediateDir, ConfigName);
-        const std::string OutputDir = std::format("{}\\{}", m_Project->Wks->OutputDir, ConfigName);
+        const std::string IntermediateDir = std::format("{}" CBUILD_PATH_SEP "{}", m_Project->Wks->IntermediateDir, ConfigName);
+        const std::string OutputDir = std::format("{}" CBUILD_PATH_SEP "{}", m_Project->Wks->OutputDir, ConfigName);
+
+        // The base command's arguments are shared by all of the project's compiles, which only add their own.
+        // Each compile lists the headers it read in a depfile (-MMD: system headers are left out).
+        List<std::string> prefix = baseCmd.Args;
+        prefix.push_back("-MMD");
+        const Command compileCmd = { .Name = baseCmd.Name, .Prefix = std::make_shared<const List<std::string>>(std::move(prefix)) };
+
+        const auto AddCompile = [&](const stdfs::path& path) -> void
+        {
+            Command cmd{ compileCmd };
+
+            const std::string PathStr = path.string();
+            const std::string IntermediateFile = std::format("{}" CBUILD_PATH_SEP "{}.o", IntermediateDir, path.stem().string());
+            cmd.Kind = CommandKind::Compile;
+            cmd.Input = PathStr;
+            cmd.Output = IntermediateFile;
+            cmd.TempOutput = Utils::MakeTemporaryFilepath(IntermediateFile);
+            cmd.Depfile = IntermediateFile + ".d";
+
+            cmd.Args.push_back("-c");
+            cmd.Args.push_back(PathStr);
+            cmd.Args.push_back("-o");
+            cmd.Args.push_back(cmd.TempOutput);
+            cmd.Args.push_back("-MF");
+            cmd.Args.push_back(cmd.Depfile);
+
+            if (m_CompileSink)
+            {
+                m_CompileSink(cmd);
+            }
+            m_Commands.push_back(std::move(cmd));
+            m_OutputFiles.push_back(std::move(IntermediateFile));
+        };
 
         for (const auto& srcdir : m_Project->SourceDirs)
         {
             const bool bSrcDirIsCwd = srcdir == "." || srcdir == "./";
             const stdfs::path dir = bSrcDirIsCwd ? cwd : (cwd / srcdir);
 
+            // Spelled as the walk would, so that the command is the same as in a full build
+            if (!m_SourceFilter.empty())
+            {
+                const stdfs::path filter{ m_SourceFilter };
+                std::error_code ec = {};
+                if (filter.parent_path().string() == Utils::MakeNormalFilepath(dir.string()) && stdfs::is_regular_file(filter, ec))
+                {
+                    AddCompile(dir / filter.filename());
+                    break;
+                }
+                continue;
+            }
+
             for (const stdfs::directory_entry& entry : stdfs::directory_iterator(dir))
             {
                 const stdfs::path& path = entry.path();
@@ -766,18 +6086,7 @@ namespace Cbuild
 
                 if (stdfs::is_regular_file(path) && (ext == ".c" || ext == ".cpp"))
                 {
-                    Command cmd{ baseCmd };
-
-                    const std::string PathStr = path.string();
-                    const std::string IntermediateFile = std::format("{}\\{}.o", IntermediateDir, path.stem().string());
-
-                    cmd.Args.push_back("-c");
-                    cmd.Args.push_back(PathStr);
-                    cmd.Args.push_back("-o");
-                    cmd.Args.push_back(IntermediateFile);
-
-                    m_Commands.push_back(std::move(cmd));
-                    m_OutputFiles.push_back(std::move(IntermediateFile));
+                    AddCompile(path);
                 }
             }
         }
@@ -791,29 +6100,55 @@ int main(int iArgc, char* ppArgv[])
 {
     const char* const* ppOldArgv = ppArgv;
 
+#if defined(CBUILD_LINUX)
+    // Blocked before any thread exists, so that every thread (the task pool, the planner) inherits
+    // the mask: these are only taken through the executor's signalfd. Otherwise the kernel could
+    // deliver one to a thread that has them unblocked, and its default action would end cbuild
+    // without stopping the compilers or removing their partial outputs. Restored on the way out,
+    // which delivers anything that arrived while no executor was listening.
+    const sigset_t signals = Cbuild::Platform::GetInterruptSignals();
+    sigset_t oldSignals = {};
+    pthread_sigmask(SIG_BLOCK, &signals, &oldSignals);
+    const auto RestoreSignals = [&oldSignals](int iExitCode) -> int
+    {
+        pthread_sigmask(SIG_SETMASK, &oldSignals, nullptr);
+        return iExitCode;
+    };
+#else
+    const auto RestoreSignals = [](int iExitCode) -> int { return iExitCode; };
+#endif // CBUILD_LINUX
+
     if (const Cbuild::Argv::BuildOptions bo{ iArgc, ppArgv })
     {
         Cbuild::Workspace wks = {};
         if (!wks.Load(bo.WksXmlFilepath))
         {
-            return -2;
+            return RestoreSignals(-2);
         }
 
-        int32_t iResult = wks.Build(bo.BuildConfiguration);
+        int32_t iResult = bo.Query ? wks.QueryReverseDependencies(bo.BuildConfiguration, bo.QueryArgs)
+            : bo.CompileFile ? wks.CompileFile(bo.BuildConfiguration, bo.Execution, bo.CompileFile, bo.SyntaxOnly)
+            : bo.Check ? wks.Check(bo.BuildConfiguration, bo.Execution, bo.Targets)
+            : wks.Build(bo.BuildConfiguration, bo.Execution, bo.Targets);
         if (iResult == Cbuild::BuildResult::CommandProcessFailed)
         {
             printf("Error: Cbuild::BuildResult::CommandProcessFailed (Please check that the project file is well defined).\n");
-            return -3;
+            return RestoreSignals(-3);
         }
         if (iResult == Cbuild::BuildResult::WksBuildFailed)
         {
             printf("Error: Cbuild::BuildResult::WksBuildFailed (Build failed, fix errors and try again).\n");
-            return -4;
+            return RestoreSignals(-4);
+        }
+        if (iResult == Cbuild::BuildResult::BuildInterrupted)
+        {
+            printf("Error: Cbuild::BuildResult::BuildInterrupted (Build was interrupted).\n");
+            return RestoreSignals(-5);
         }
 
-        return 0;
+        return RestoreSignals(0);
     }
 
-    return -1;
+    return RestoreSignals(-1);
 }
 
@@ -16,11 +16,14 @@
 	#endif //!NOMINMAX
 
     #define CBUILD_SHARED_LIB_EXT "dll"
+    #define CBUILD_PATH_SEP "\\"
 #elif defined(CBUILD_LINUX)
     #define CBUILD_SHARED_LIB_EXT "so"
+    #define CBUILD_PATH_SEP "/"
 #else
     #error "Unknown or unsupported platform"
     #define CBUILD_SHARED_LIB_EXT ""
+    #define CBUILD_PATH_SEP ""
 #endif // CBUILD_WIN32
 
 #define CBUILD_VERSION_MAJOR 0
@@ -31,8 +34,11 @@
 
 #include <stdint.h>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
+#include <memory>
+#include <functional>
 
 namespace Cbuild
 {
@@ -55,20 +61,64 @@ namespace Cbuild
     };
 
 
+    enum class CommandKind : uint16_t
+    {
+        Compile = 0,
+        Link,
+        Archive,
+        Custom,
+    };
+
+
     struct Command
     {
         std::string Name = {};
-        List<std::string> Args = {};
+        std::shared_ptr<const List<std::string>> Prefix = {}; // Leading arguments, shared by the commands of a project (may be null)
+        List<std::string> Args = {}; // The arguments of this command (after `Prefix`)
+        CommandKind Kind = CommandKind::Custom;
+        std::string Input = {}; // Primary input (the source file, for compile commands)
+        std::string Output = {};
+        std::string TempOutput = {}; // Where the command writes `Output` (renamed to it once the command succeeds)
+        std::string Depfile = {}; // Where the command lists the headers it read (compile commands, read back into the build database)
         
         operator bool() const noexcept;
+        size_t GetArgCount() const noexcept;
+
+        // Calls `Fn` with every argument, `Prefix` first
+        template<typename F>
+        void ForEachArg(F&& Fn) const noexcept
+        {
+            if (Prefix)
+            {
+                for (const std::string& arg : *Prefix)
+                {
+                    Fn(arg);
+                }
+            }
+            for (const std::string& arg : Args)
+            {
+                Fn(arg);
+            }
+        }
+    };
+
+
+    // Caps how many of its steps run at once (a la ninja's `pool`)
+    struct Pool
+    {
+        std::string_view Name = {};
+        uint32_t Depth = 1;
+        List<CommandKind> Kinds = {}; // Steps of these kinds go to this pool, unless a project says otherwise
     };
 
 
+    // The strings of the workspace model (Configuration, Project, Workspace) are views into
+    // `Workspace::Storage`, or literals. Once loaded they are interned: equal strings share their data.
     struct Configuration
     {
-        std::string Name = {};
-        List<std::string> Flags = {};
-        List<std::string> Defines = {};
+        std::string_view Name = {};
+        List<std::string_view> Flags = {};
+        List<std::string_view> Defines = {};
     };
 
 
@@ -77,41 +127,62 @@ namespace Cbuild
         static inline constexpr const char* const DefaultBuildConfiguration = "Debug";
 
         struct Workspace* Wks = nullptr;
-        std::string Name = {};
-        std::string Arch = {};
-        std::string Language = {};
-        std::string CVersion = {};
-        std::string CppVersion = {};
-        std::string Compiler = {};
-        List<std::string> Defines = {};
-        List<std::string> IncludeDirs = {};
-        List<std::string> SourceDirs = {};
-        List<std::string> LibraryDirs = {};
-        List<std::string> References = {};
+        std::string_view Name = {};
+        std::string_view Arch = {};
+        std::string_view Language = {};
+        std::string_view CVersion = {};
+        std::string_view CppVersion = {};
+        std::string_view Compiler = {};
+        List<std::string_view> Defines = {};
+        List<std::string_view> IncludeDirs = {};
+        List<std::string_view> SourceDirs = {};
+        List<std::string_view> LibraryDirs = {};
+        List<std::string_view> References = {};
         List<Command> PreBuildCommands = {};
         List<Command> PostBuildCommands = {};
-        Dictionary<Configuration> Configurations = {};
+        Map<std::string_view, Configuration> Configurations = {};
+        std::string_view Pool = {}; // Pool for all steps of this project
+        Map<CommandKind, std::string_view> StepPools = {}; // Pool per step kind (takes precedence over `Pool`)
         BuildOutputKind OutputKind = BuildOutputKind::ConsoleApp;
         bool InferCompilerFromExtensionsOrLanguage = false; // TODO: Implement
     };
 
 
+    struct ExecutionOptions
+    {
+        uint32_t Jobs = 0; // 0 = one per usable CPU (affinity mask and cgroup quota)
+        uint64_t MemoryBudgetKb = 0; // 0 = available memory (RAM or the cgroup limit)
+        double MaxLoad = 0.0; // Don't start jobs while the 1-minute load average is above this (0 = off)
+        double MaxCpuPressure = 0.0; // Same, with the CPU pressure (PSI "some avg10", in %)
+        bool DeleteFailedOutputs = false; // Also remove the previous output of a job that fails
+        uint32_t MaxFailures = 1; // Stop (killing the running jobs) after this many failures: 1 = fail fast (the default, as ninja), 0 = never
+        uint32_t MaxBatch = 1; // Small compiles of a project that may share one compiler process, 1 = never batch (opt in with `--batch <n>`)
+        bool BypassDriver = false; // Run GCC's cc1/cc1plus | as directly instead of its driver (Linux; where the driver says how)
+        bool Verbose = false; // Show full command lines instead of short descriptions
+    };
+
+
     struct Workspace
     {
-        std::string Name = {};
-        std::string Cwd = {};
-        std::string OutputDir = {};
-        std::string IntermediateDir = {}; // TODO: Implement
+        std::string_view Name = {};
+        std::string_view Cwd = {};
+        std::string_view OutputDir = {};
+        std::string_view IntermediateDir = {}; // TODO: Implement
         List<Project> Projects = {};
+        List<Pool> Pools = {};
+        std::shared_ptr<const void> Storage = {}; // Owns the text the model points into (the mapped XML or snapshot)
         bool CheckOutputFilesBeforeBuild = false; // TODO: Implement
-        bool DeleteOutputFilesIfBuildFails = false; // TODO: Implement
+        bool DeleteOutputFilesIfBuildFails = false;
         bool ExecutePreBuildCommands = false; // TODO: Implement
         bool ExecutePostBuildCommands = false; // TODO: Implement
 
         bool Load(const char* lpXmlFilepath) noexcept;
         bool CheckOutputFiles() noexcept;
         bool DeleteOutputFiles() noexcept;
-        int32_t Build(const char* lpConfiguration) const noexcept;
+        int32_t Build(const char* lpConfiguration, const ExecutionOptions& Options, const List<const char*>& Targets = {}) const noexcept; // Only what the targets (projects, or files they build) need, if any
+        int32_t Check(const char* lpConfiguration, const ExecutionOptions& Options, const List<const char*>& Targets = {}) const noexcept; // Parses the sources that changed (-fsyntax-only), nothing is built
+        int32_t CompileFile(const char* lpConfiguration, const ExecutionOptions& Options, const char* lpFilepath, bool bSyntaxOnly) const noexcept; // One source, as the build would (for editors)
+        int32_t QueryReverseDependencies(const char* lpConfiguration, const List<const char*>& Filepaths) const noexcept; // Prints what a change to the files affects
     };
 
 
@@ -120,7 +191,9 @@ namespace Cbuild
     public:
         inline constexpr IProjectBuilder() noexcept = default;
         inline virtual ~IProjectBuilder() noexcept = default;
-        virtual int32_t Build(const char* lpConfiguration) noexcept = 0;
+        virtual int32_t Plan(const char* lpConfiguration) noexcept = 0; // Generates m_Commands, the final command is always last
+        void SetCompileSink(std::function<void(const Command&)> Sink) noexcept; // Also gets each compile as soon as Plan() finds its source
+        void SetSourceFilter(std::string Filepath) noexcept; // Plan() only compiles this source (a normal filepath), without walking the source directories
         const List<Command>& GetBuildCommands() const noexcept;
         // const List<std::string>& GetOutputFiles() const noexcept; // TODO: Include?
         const Project* GetProject() const noexcept;
@@ -133,6 +206,8 @@ namespace Cbuild
     protected:
         List<Command> m_Commands = {};
         List<std::string> m_OutputFiles = {};
+        std::function<void(const Command&)> m_CompileSink = {};
+        std::string m_SourceFilter = {};
         const Project* m_Project = nullptr;
         BuildOutputKind m_Kind = (BuildOutputKind)(-1);
     };
@@ -155,24 +230,24 @@ namespace Cbuild
 // ==============================
 // A. ConsoleApp
 // ==============================
-// CC DEFINE... INCLUDE... <opt>... -c FILE -o outfile.o
-// CC DEFINE... INCLUDE... <opt>... -c FILE -o outfile.o
+// CC DEFINE... INCLUDE... <opt>... -MMD -c FILE -o outfile.o -MF outfile.o.d
+// CC DEFINE... INCLUDE... <opt>... -MMD -c FILE -o outfile.o -MF outfile.o.d
 // ...
 // CC OUTFILE... LIBDIR... REFS... -o <proj_name.exe>
 // 
 // ==============================
 // B. StaticLibrary
 // ==============================
-// CC DEFINE... INCLUDE... LIBDIR... REFS... <opt>... -c FILE -o outfile.o
-// CC DEFINE... INCLUDE... LIBDIR... REFS... <opt>... -c FILE -o outfile.o
+// CC DEFINE... INCLUDE... LIBDIR... REFS... <opt>... -MMD -c FILE -o outfile.o -MF outfile.o.d
+// CC DEFINE... INCLUDE... LIBDIR... REFS... <opt>... -MMD -c FILE -o outfile.o -MF outfile.o.d
 // ...
 // ar -rc -o <proj_name.lib> OUTFILE...
 // 
 // ==============================
 // C. SharedLibrary
 // ==============================
-// CC DEFINE... INCLUDE... LIBDIR... REFS... <opt>... -c FILE -o outfile.o
-// CC DEFINE... INCLUDE... LIBDIR... REFS... <opt>... -c FILE -o outfile.o
+// CC DEFINE... INCLUDE... LIBDIR... REFS... <opt>... -MMD -c FILE -o outfile.o -MF outfile.o.d
+// CC DEFINE... INCLUDE... LIBDIR... REFS... <opt>... -MMD -c FILE -o outfile.o -MF outfile.o.d
 // ...
 // CC -shared -o <proj_name.dll> OUTFILE...
 // 
@@ -0,0 +1,63 @@
+# Compiles batched into one compiler process (--batch) make the same objects as compiles of their own, with a
+# relative compiler and relative paths in the flags, and a batch counts each of its compiles against its pool.
+. "$(dirname "$0")/lib.sh"
+
+mkdir -p src inc sys
+echo '#define FORCED 1' > inc/forced.h
+echo 'static int sys_value(void) { return 2; }' > sys/s.h
+for i in $(seq 1 24); do
+    printf '#include <s.h>\nint f%d(void) { return FORCED + sys_value() + %d; }\n' $i $i > "src/f$i.c"
+done
+echo 'int main(void) { return 0; }' > src/main.c
+
+# Logs how many sources each compiler process got
+cat > cc.sh <<'SH'
+#!/bin/sh
+n=0
+for arg; do
+    case "$arg" in *.c) n=$((n + 1));; esac
+done
+echo $n >> "$(dirname "$0")/sources"
+exec gcc "$@"
+SH
+chmod +x cc.sh
+
+write_xml()
+{
+    cat > ws.xml <<XML
+<Workspace Name="Tests">
+    <OutputDir>bin</OutputDir>
+    <IntermediateDir>bin-int</IntermediateDir>
+    $1
+    <Project Name="App" Kind="ConsoleApp" Language="C" Compiler="./cc.sh">
+        <Configuration Name="Debug"><Flags><Item>O0</Item><Item>g</Item><Item>includeinc/forced.h</Item><Item>isystemsys</Item></Flags></Configuration>
+        <SourceDirs><Item>src</Item></SourceDirs>
+    </Project>
+</Workspace>
+XML
+}
+
+build()
+{
+    rm -rf bin bin-int sources ws.xml.cbuild_cache
+    mkdir -p bin/Debug bin-int/Debug
+    "$CBUILD" ws.xml --config Debug "$@" > log 2>&1 || fail "the build failed ($*)"
+}
+
+write_xml ""
+build -j 4
+mkdir ref
+cp bin-int/Debug/*.o ref/
+[ "$(sort -n sources | tail -1)" = "1" ] || fail "compiles were batched without --batch"
+
+build -j 2 --batch 8
+[ "$(sort -n sources | tail -1)" -gt 1 ] || fail "nothing was batched"
+for obj in ref/*.o; do
+    cmp -s "$obj" "bin-int/Debug/$(basename "$obj")" || fail "$(basename "$obj") differs from the one compiled on its own"
+done
+
+write_xml '<Pools><Pool Name="compiles" Depth="2"><Item>Compile</Item></Pool></Pools>'
+build -j 1 --batch 16
+kLargest=$(sort -n sources | tail -1)
+[ "$kLargest" -le 2 ] || fail "a batch of $kLargest compiles ran in a pool of depth 2"
+exit 0
@@ -0,0 +1,55 @@
+# --bypass-driver runs the compiler proper and the assembler that gcc would run (asking it once with -###)
+# rather than gcc itself, making the same objects and depfiles; a driver it cannot read compiles as usual.
+. "$(dirname "$0")/lib.sh"
+
+write_project ws.xml App ConsoleApp ./cc.sh
+echo 'int f(void) { return 1; }' > src/f.c
+echo 'int g(void) { return 2; }' > src/g.c
+printf '#include "m.h"\nint f(void); int g(void); int main(void) { return f() + g() == M ? 0 : 1; }\n' > src/main.c
+echo '#define M 3' > src/m.h
+
+# Logs each compiler command line
+cat > cc.sh <<'SH'
+#!/bin/sh
+echo "$*" >> "$(dirname "$0")/commands"
+exec gcc "$@"
+SH
+chmod +x cc.sh
+
+# build <args...>: a clean build, with the compiles the driver ran in $kDriven
+build()
+{
+    rm -rf bin/Debug/* bin-int/Debug/* commands .cbuild_db
+    "$CBUILD" ws.xml --config Debug "$@" > log 2>&1 || fail "the build failed ($*)"
+    ./bin/Debug/App.exe || fail "the program does not run ($*)"
+    kDriven=$(grep -- " -c " commands | grep -vc -- "-###")
+}
+
+build
+[ "$kDriven" -eq 3 ] || fail "the driver ran $kDriven compiles instead of 3"
+mkdir ref
+cp bin-int/Debug/*.o ref/
+
+build --bypass-driver
+[ "$kDriven" -eq 0 ] || fail "the driver still ran $kDriven compiles with --bypass-driver"
+grep -q -- "-###" commands || fail "the driver was not asked what it runs"
+for obj in ref/*.o; do
+    cmp -s "$obj" "bin-int/Debug/$(basename "$obj")" || fail "$(basename "$obj") differs from the one the driver compiled"
+done
+# Its headers were recorded from the depfile
+sleep 1
+echo '#define M (1 + 2)' > src/m.h
+"$CBUILD" ws.xml --config Debug --bypass-driver > log 2>&1 || fail "the rebuild failed"
+[ bin-int/Debug/main.o -nt src/m.h ] || fail "main.o was not recompiled after a change to m.h"
+[ bin-int/Debug/f.o -nt src/m.h ] && fail "f.o was recompiled after a change to m.h"
+
+# A driver that does not say what it runs
+cat > cc.sh <<'SH'
+#!/bin/sh
+echo "$*" >> "$(dirname "$0")/commands"
+case " $* " in *" -### "*) exit 0;; esac
+exec gcc "$@"
+SH
+build --bypass-driver
+[ "$kDriven" -eq 3 ] || fail "the driver ran $kDriven compiles instead of 3 when it could not be bypassed"
+exit 0
@@ -0,0 +1,56 @@
+# --check parses the sources (-fsyntax-only) and writes no objects; a source parsed fine is skipped until it,
+# or a header it includes, changes, and a broken one fails every check until it is fixed.
+. "$(dirname "$0")/lib.sh"
+
+write_project ws.xml App ConsoleApp ./cc.sh
+echo '#define A 1' > src/a.h
+printf '#include "a.h"\nint a(void) { return A; }\n' > src/a.c
+echo 'int b(void) { return 2; }' > src/b.c
+echo 'int main(void) { return 0; }' > src/main.c
+
+# Logs the sources parsed
+cat > cc.sh <<'SH'
+#!/bin/sh
+case " $* " in *" -fsyntax-only "*)
+    for arg; do
+        case "$arg" in *.c) basename "$arg" >> "$(dirname "$0")/parsed";; esac
+    done;;
+esac
+exec gcc "$@"
+SH
+chmod +x cc.sh
+
+# check: a --check, with the sources it parsed in $parsed
+check()
+{
+    rm -f parsed
+    touch parsed
+    "$CBUILD" ws.xml --config Debug --check > log 2>&1
+    kExitCode=$?
+    parsed=$(sort parsed | tr '\n' ' ')
+}
+
+check
+[ $kExitCode -eq 0 ] || fail "the first check failed"
+[ "$parsed" = "a.c b.c main.c " ] || fail "the first check parsed '$parsed' instead of every source"
+[ -z "$(find bin-int bin -name '*.o' -o -name '*.exe')" ] || fail "--check wrote objects or programs"
+
+check
+[ $kExitCode -eq 0 ] || fail "the second check failed"
+[ -z "$parsed" ] || fail "the second check parsed '$parsed' again"
+
+sleep 1
+echo '#define A 2' > src/a.h
+check
+[ "$parsed" = "a.c " ] || fail "a change to a.h had '$parsed' parsed instead of a.c"
+
+echo 'int b(void) { return }' > src/b.c
+check
+[ $kExitCode -ne 0 ] || fail "the check passed a broken source"
+[ "$parsed" = "b.c " ] || fail "a change to b.c had '$parsed' parsed instead of b.c"
+
+# Failed: not skipped the next time
+check
+[ $kExitCode -ne 0 ] || fail "the broken source passed the next check"
+[ "$parsed" = "b.c " ] || fail "the next check parsed '$parsed' instead of the broken b.c"
+exit 0
@@ -0,0 +1,38 @@
+# --compile-file compiles the one source (up to date or not) as the build would and nothing else, and with
+# --syntax-only it only parses it, writing no object.
+. "$(dirname "$0")/lib.sh"
+
+write_project ws.xml App ConsoleApp ./cc.sh
+echo 'int a(void) { return 1; }' > src/a.c
+echo 'int b(void) { return 2; }' > src/b.c
+echo 'int main(void) { return 0; }' > src/main.c
+
+# Logs each compiler command line
+cat > cc.sh <<'SH'
+#!/bin/sh
+echo "$*" >> "$(dirname "$0")/commands"
+exec gcc "$@"
+SH
+chmod +x cc.sh
+
+"$CBUILD" ws.xml --config Debug --compile-file src/a.c > log 2>&1 || fail "--compile-file failed"
+[ -f bin-int/Debug/a.o ] || fail "--compile-file wrote no object"
+[ -e bin-int/Debug/b.o ] && fail "--compile-file compiled another source"
+[ -e bin/Debug/App.exe ] && fail "--compile-file linked"
+[ "$(wc -l < commands)" -eq 1 ] || fail "--compile-file ran $(wc -l < commands) commands instead of 1"
+
+# Up to date, and compiled all the same
+"$CBUILD" ws.xml --config Debug --compile-file src/a.c > log 2>&1 || fail "--compile-file failed the second time"
+[ "$(wc -l < commands)" -eq 2 ] || fail "--compile-file skipped the up to date source"
+
+rm -f bin-int/Debug/a.o
+"$CBUILD" ws.xml --config Debug --compile-file src/a.c --syntax-only > log 2>&1 || fail "--syntax-only failed"
+tail -1 commands | grep -q -- "-fsyntax-only" || fail "--syntax-only did not only parse"
+[ -e bin-int/Debug/a.o ] && fail "--syntax-only wrote an object"
+
+echo 'int a(void) { return }' > src/a.c
+"$CBUILD" ws.xml --config Debug --compile-file src/a.c --syntax-only > log 2>&1 && fail "--syntax-only passed a broken source"
+
+"$CBUILD" ws.xml --config Debug --compile-file ws.xml > log 2>&1 && fail "--compile-file took a file that is no source"
+grep -q "is not a C or C++ source" log || fail "--compile-file did not say why it refused ws.xml"
+exit 0
@@ -0,0 +1,38 @@
+# SIGTERM during a build with several compiles (and cbuild's own threads) running: cbuild must stop
+# its compilers, remove their partial outputs and report the interruption instead of dying outright.
+. "$(dirname "$0")/lib.sh"
+
+cat > slowcc <<'SH'
+#!/bin/sh
+echo $$ >> "$(dirname "$0")/pids"
+prev=
+for arg; do
+    [ "$prev" = "-o" ] && : > "$arg"
+    prev=$arg
+done
+exec sleep 60
+SH
+chmod +x slowcc
+
+write_project ws.xml App ConsoleApp "$WS/slowcc"
+for i in $(seq 1 16); do
+    echo "int f$i(void) { return $i; }" > "src/f$i.c"
+done
+
+"$CBUILD" ws.xml --config Debug -j 4 > log 2>&1 &
+kCbuild=$!
+
+compiles_running() { [ -f pids ] && [ "$(wc -l < pids)" -ge 4 ]; }
+wait_for 20 compiles_running || fail "the compiles never started"
+kill -TERM $kCbuild
+wait $kCbuild
+kExitCode=$?
+
+[ $kExitCode -eq 251 ] || fail "exited with $kExitCode instead of reporting the interruption (-5)"
+grep -q "BuildInterrupted" log || fail "the interruption was not reported"
+while read -r kPid; do
+    kill -0 "$kPid" 2> /dev/null && fail "compiler $kPid is still running"
+done < pids
+leftovers=$(find bin bin-int -name "*.o" -o -name "*.tmp*")
+[ -z "$leftovers" ] || fail "partial outputs were left behind: $leftovers"
+exit 0
@@ -0,0 +1,52 @@
+# cbuild shares one job limit with make: under `make -j2` it runs two compiles at once (holding make's
+# tokens), and with -j 3 it serves a jobserver that a make run by one of its jobs draws from.
+. "$(dirname "$0")/lib.sh"
+
+write_project ws.xml App ConsoleApp ./cc.sh
+for i in $(seq 1 6); do
+    echo "int f$i(void) { return $i; }" > "src/f$i.c"
+done
+echo 'int main(void) { return 0; }' > src/main.c
+
+# Logs when each compile starts and ends, and holds it long enough to overlap the others
+cat > cc.sh <<'SH'
+#!/bin/sh
+echo + >> "$(dirname "$0")/running"
+sleep 0.3
+gcc "$@"
+kExitCode=$?
+echo - >> "$(dirname "$0")/running"
+exit $kExitCode
+SH
+chmod +x cc.sh
+
+# get_max_running: how many of the logged jobs ran at once, at most
+get_max_running()
+{
+    awk '/\+/ { n++; if (n > max) max = n } /-/ { n-- } END { print max + 0 }' running
+}
+
+# As a client: make's two slots (its own and one token), no -j of its own
+printf 'all:\n\t+"$(CBUILD)" ws.xml --config Debug\n' > Makefile
+make -s -j2 CBUILD="$CBUILD" > log 2>&1 || fail "the build under make failed"
+kMaxRunning=$(get_max_running)
+[ "$kMaxRunning" -eq 2 ] || fail "ran $kMaxRunning compiles at once under make -j2"
+
+# As a server: the only compile runs a make, which gets the two slots the compile does not use
+rm -rf src/f*.c running bin/Debug/* bin-int/Debug/* .cbuild_db
+cat > sub.mk <<'MK'
+all: s1 s2 s3 s4
+s1 s2 s3 s4:
+	@echo + >> running; sleep 0.5; echo - >> running
+MK
+cat > cc.sh <<'SH'
+#!/bin/sh
+cd "$(dirname "$0")" && echo "$MAKEFLAGS" > makeflags && make -s -f sub.mk || exit 1
+exec gcc "$@"
+SH
+# Under variables passed on by a make of its own (as `make test` does), which must not take the options
+MAKEFLAGS=" -- V=1" "$CBUILD" ws.xml --config Debug -j 3 > log 2>&1 || fail "the build failed"
+grep -q -- "--jobserver-auth=" makeflags || fail "the jobserver was not advertised in MAKEFLAGS"
+kMaxRunning=$(get_max_running)
+[ "$kMaxRunning" -eq 3 ] || fail "the sub-make ran $kMaxRunning jobs at once instead of 3"
+exit 0
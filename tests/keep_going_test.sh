@@ -0,0 +1,38 @@
+# A build with broken sources: by default it stops at the first failure (fail fast), with -k N once N
+# jobs failed, and with -k 0 it keeps going, compiling everything else and reporting each failure.
+. "$(dirname "$0")/lib.sh"
+
+write_project ws.xml App ConsoleApp gcc
+for i in $(seq 1 6); do
+    echo "int f$i(void) { return $i; }" > "src/f$i.c"
+done
+for i in $(seq 1 3); do
+    echo "int broken$i(void) { return }" > "src/broken$i.c"
+done
+echo 'int main(void) { return 0; }' > src/main.c
+
+# build <args...>: a clean build, one job at a time so that failures are counted in order
+build()
+{
+    rm -rf bin-int/Debug/* bin/Debug/* .cbuild_db
+    "$CBUILD" ws.xml --config Debug -j 1 "$@" > log 2>&1
+    kExitCode=$?
+    kFailed=$(grep -c "^FAILED: " log)
+    kObjects=$(find bin-int -name "*.o" | wc -l)
+}
+
+build
+[ $kExitCode -eq 252 ] || fail "exited with $kExitCode instead of reporting the failed build (-4)"
+[ "$kFailed" -eq 1 ] || fail "reported $kFailed failures instead of stopping at the first"
+[ $(( kObjects + kFailed )) -lt 10 ] || fail "went on compiling after the first failure"
+
+build -k 2
+[ $kExitCode -eq 252 ] || fail "-k 2 exited with $kExitCode instead of reporting the failed build (-4)"
+[ "$kFailed" -eq 2 ] || fail "-k 2 reported $kFailed failures instead of stopping at the second"
+
+build -k 0
+[ $kExitCode -eq 252 ] || fail "-k 0 exited with $kExitCode instead of reporting the failed build (-4)"
+[ "$kFailed" -eq 3 ] || fail "-k 0 reported $kFailed failures instead of 3"
+[ "$kObjects" -eq 7 ] || fail "-k 0 compiled $kObjects of the 7 good sources"
+[ -e bin/Debug/App.exe ] && fail "-k 0 linked despite the failed compiles"
+exit 0
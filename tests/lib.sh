@@ -0,0 +1,44 @@
+# Shared by the tests: each one gets an empty workspace directory ($WS), removed when it exits.
+# The cbuild under test is $CBUILD (set by run.sh).
+
+set -u
+
+CBUILD=$(realpath "${CBUILD:?run the tests through tests/run.sh}")
+WS=$(mktemp -d)
+trap 'rm -rf "$WS"' EXIT
+cd "$WS"
+
+fail()
+{
+    echo "FAIL: $(basename "$0"): $*"
+    [ -f "$WS/log" ] && sed 's/^/    /' "$WS/log"
+    exit 1
+}
+
+# write_project <xml> <name> <kind> <compiler> [srcdir]: a C project with its sources in <srcdir> (default: src)
+write_project()
+{
+    mkdir -p bin/Debug bin-int/Debug "${5:-src}"
+    cat > "$1" <<XML
+<Workspace Name="Tests">
+    <OutputDir>bin</OutputDir>
+    <IntermediateDir>bin-int</IntermediateDir>
+    <Project Name="$2" Kind="$3" Language="C" Compiler="$4">
+        <Configuration Name="Debug"><Flags><Item>O0</Item></Flags></Configuration>
+        <SourceDirs><Item>${5:-src}</Item></SourceDirs>
+    </Project>
+</Workspace>
+XML
+}
+
+# wait_for <seconds> <command...>: polls until the command succeeds
+wait_for()
+{
+    local kTries=$(( $1 * 10 ))
+    shift
+    while ! "$@"; do
+        kTries=$(( kTries - 1 ))
+        [ $kTries -gt 0 ] || return 1
+        sleep 0.1
+    done
+}
@@ -0,0 +1,34 @@
+# Links get their arguments from a response file (bin/Debug/App.exe.rsp), quoted so that paths with spaces
+# survive, and the file is left alone when a relink has the same arguments.
+. "$(dirname "$0")/lib.sh"
+
+write_project ws.xml App ConsoleApp ./cc.sh
+echo 'int f(void) { return 1; }' > src/f.c
+echo 'int g(void) { return 2; }' > "src/with space.c"
+echo 'int f(void); int g(void); int main(void) { return f() + g() == 3 ? 0 : 1; }' > src/main.c
+
+# Logs each compiler command line
+cat > cc.sh <<'SH'
+#!/bin/sh
+echo "$*" >> "$(dirname "$0")/commands"
+exec gcc "$@"
+SH
+chmod +x cc.sh
+
+"$CBUILD" ws.xml --config Debug > log 2>&1 || fail "the build failed"
+./bin/Debug/App.exe || fail "the program does not run"
+[ -f bin/Debug/App.exe.rsp ] || fail "the link wrote no response file"
+[ "$(grep -cx "@bin/Debug/App.exe.rsp" commands)" -eq 1 ] || fail "the link was not given just @bin/Debug/App.exe.rsp, once"
+for obj in f main 'with\ space'; do
+    grep -qxF "bin-int/Debug/$obj.o" bin/Debug/App.exe.rsp || fail "the response file does not list $obj.o (escaped)"
+done
+
+# Same arguments: the same file, not rewritten
+kInode=$(stat -c %i bin/Debug/App.exe.rsp)
+sleep 1
+echo 'int f(void) { return 1 + 0; }' > src/f.c
+"$CBUILD" ws.xml --config Debug > log 2>&1 || fail "the relink failed"
+[ "$(grep -cx "@bin/Debug/App.exe.rsp" commands)" -eq 2 ] || fail "did not relink"
+[ "$(stat -c %i bin/Debug/App.exe.rsp)" = "$kInode" ] || fail "the response file was rewritten with the same arguments"
+./bin/Debug/App.exe || fail "the relinked program does not run"
+exit 0
@@ -0,0 +1,23 @@
+#!/usr/bin/env bash
+# Usage: tests/run.sh <cbuild> [unit-tests]
+# Runs the unit tests (if given) and every tests/*_test.sh against <cbuild>.
+
+kFailed=0
+kTotal=0
+
+if [ $# -ge 2 ]; then
+    kTotal=$(( kTotal + 1 ))
+    "$2" || kFailed=$(( kFailed + 1 ))
+fi
+
+for test in "$(dirname "$0")"/*_test.sh; do
+    kTotal=$(( kTotal + 1 ))
+    if CBUILD="$1" bash "$test"; then
+        echo "ok: $(basename "$test")"
+    else
+        kFailed=$(( kFailed + 1 ))
+    fi
+done
+
+echo "$(( kTotal - kFailed ))/$kTotal passed"
+[ $kFailed -eq 0 ]
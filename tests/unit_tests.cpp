@@ -0,0 +1,676 @@
+// Unit tests of what is easier to get at from code than through a build, one function per part of cbuild.
+// Each test runs in an empty directory of its own. Prints what failed, returns non-zero if anything did.
+#define main cbuild_main
+#include "cbuild.cpp"
+#undef main
+
+#define CHECK(expr) \
+    do { if (!(expr)) { printf("FAIL: unit_tests: %s: %s (line %d)\n", g_Test, #expr, __LINE__); g_Failures++; } } while (0)
+
+namespace
+{
+
+    using Cbuild::List;
+
+    uint32_t g_Failures = 0;
+    const char* g_Test = "";
+
+    void WriteFile(const std::string& Filepath, std::string_view Text) noexcept
+    {
+        namespace stdfs = std::filesystem;
+
+        std::error_code ec = {};
+        if (stdfs::path{ Filepath }.has_parent_path())
+        {
+            stdfs::create_directories(stdfs::path{ Filepath }.parent_path(), ec);
+        }
+        std::ofstream ofs{ Filepath, std::ios::binary | std::ios::trunc };
+        ofs << Text;
+    }
+
+    std::string ReadFile(const std::string& Filepath) noexcept
+    {
+        std::ifstream ifs{ Filepath, std::ios::binary };
+        return { std::istreambuf_iterator<char>{ ifs }, std::istreambuf_iterator<char>{} };
+    }
+
+    List<std::string> GetHeaders(const Cbuild::Exec::BuildDatabase& Db, const Cbuild::Exec::NodeRecord& Record) noexcept
+    {
+        List<std::string> headers = {};
+        for (const uint32_t kHeader : Record.Headers)
+        {
+            headers.push_back(Db.GetHeader(kHeader));
+        }
+        std::sort(headers.begin(), headers.end());
+        return headers;
+    }
+
+
+    void TestBuildDatabaseRoundTrip() noexcept
+    {
+        using namespace Cbuild::Exec;
+
+        {
+            BuildDatabase db = {};
+            CHECK(!db.Load("db/.cbuild_db")); // Not there yet
+            NodeRecord& record = db.Touch("a.o");
+            record.DurationMs = 1234;
+            record.PeakRssKb = 56789;
+            record.ResponseFileHash = 0xfeedull;
+            record.CommandHash = 0xdeadbeefcafeull;
+            db.SetHeaders("a.o", List<std::string>{ "/inc/2.h", "/inc/1.h", "/inc/1.h" });
+            db.SetHeaders("b.o", List<std::string_view>{ "/inc/2.h" });
+            db.SetHeaders("c.o", List<std::string>{});
+            db.SetScan("/inc/1.h", ScanRecord{ .ModifiedTime = 42, .Includes = { "\"2.h", "<stdio.h" } });
+            CHECK(db.Save());
+        }
+
+        BuildDatabase db = {};
+        CHECK(db.Load("db/.cbuild_db"));
+        const NodeRecord* pA = db.Find("a.o");
+        CHECK(pA && pA->DurationMs == 1234 && pA->PeakRssKb == 56789 && pA->ResponseFileHash == 0xfeedull && pA->CommandHash == 0xdeadbeefcafeull);
+        CHECK(pA && GetHeaders(db, *pA) == (List<std::string>{ "/inc/1.h", "/inc/2.h" }));
+        CHECK(db.Find("c.o") && db.Find("c.o")->Headers.empty());
+        CHECK(!db.Find("d.o"));
+
+        const List<const std::string*>* pIncluders = db.FindIncluders("/inc/2.h");
+        CHECK(pIncluders && pIncluders->size() == 2ull);
+        CHECK(!db.FindIncluders("/inc/3.h"));
+
+        uint32_t kScans = 0;
+        db.ForEachScan([&kScans](const std::string& Filepath, const ScanRecord& Scan)
+        {
+            kScans++;
+            CHECK(Filepath == "/inc/1.h" && Scan.ModifiedTime == 42 && Scan.Includes == (List<std::string>{ "\"2.h", "<stdio.h" }));
+        });
+        CHECK(kScans == 1);
+    }
+
+    void TestBuildDatabaseJournal() noexcept
+    {
+        using namespace Cbuild::Exec;
+
+        {
+            BuildDatabase db = {};
+            db.Load(".cbuild_db");
+            db.Touch("a.o").DurationMs = 1;
+            db.SetHeaders("a.o", List<std::string>{ "/inc/1.h" });
+            CHECK(db.Save());
+        }
+
+        // Journaled records survive without a save, later lines winning over the snapshot
+        {
+            BuildDatabase db = {};
+            CHECK(db.Load(".cbuild_db"));
+            db.Touch("a.o").DurationMs = 2;
+            db.SetHeaders("a.o", List<std::string>{ "/inc/1.h", "/inc/new.h" });
+            db.Journal("a.o");
+            db.Touch("b.o").DurationMs = 3;
+            db.SetHeaders("b.o", List<std::string>{ "/inc/new.h" });
+            db.Journal("b.o");
+        }
+        {
+            BuildDatabase db = {};
+            CHECK(db.Load(".cbuild_db"));
+            CHECK(db.Find("a.o") && db.Find("a.o")->DurationMs == 2);
+            CHECK(db.Find("a.o") && GetHeaders(db, *db.Find("a.o")) == (List<std::string>{ "/inc/1.h", "/inc/new.h" }));
+            CHECK(db.Find("b.o") && db.Find("b.o")->DurationMs == 3);
+            CHECK(db.FindIncluders("/inc/new.h") && db.FindIncluders("/inc/new.h")->size() == 2ull);
+        }
+
+        // A record cut short (by a kill) is ignored, and not appended to
+        {
+            std::ofstream ofs{ ".cbuild_db", std::ios::app | std::ios::binary };
+            ofs << "H\t/inc/cut.h\n9\t0\t0\t0\t2\tcut";
+        }
+        {
+            BuildDatabase db = {};
+            CHECK(db.Load(".cbuild_db"));
+            CHECK(!db.Find("cut"));
+            db.Touch("c.o").DurationMs = 4;
+            db.SetHeaders("c.o", List<std::string>{ "/inc/1.h" });
+            db.Journal("c.o");
+        }
+        {
+            const std::string text = ReadFile(".cbuild_db");
+            CHECK(text.ends_with("\tc.o\n"));
+            CHECK(text.find("\tcut") == std::string::npos);
+
+            BuildDatabase db = {};
+            CHECK(db.Load(".cbuild_db"));
+            CHECK(db.Find("a.o") && db.Find("a.o")->DurationMs == 2);
+            CHECK(db.Find("c.o") && db.Find("c.o")->DurationMs == 4);
+            CHECK(db.Find("c.o") && GetHeaders(db, *db.Find("c.o")) == (List<std::string>{ "/inc/1.h" }));
+        }
+
+        // Of another version: starts over
+        WriteFile(".cbuild_db", "CBUILDDB 4\n1\t0\t0\t0\t-\ta.o\n");
+        {
+            BuildDatabase db = {};
+            CHECK(!db.Load(".cbuild_db"));
+            CHECK(!db.Find("a.o"));
+        }
+    }
+
+    bool LoadWorkspace(Cbuild::Workspace* pWks, const char* lpXml) noexcept
+    {
+        WriteFile("ws.xml", lpXml);
+        return pWks->Load("ws.xml");
+    }
+
+    void TestWorkspaceSnapshot() noexcept
+    {
+        using namespace Cbuild;
+
+        const char* lpXml =
+            "<Workspace Name=\"Tests\">\n"
+            "  <Pools><Pool Name=\"link\" Depth=\"1\"><Item>Link</Item></Pool></Pools>\n"
+            "  <Project Name=\"Lib\" Kind=\"StaticLibrary\" Language=\"C++\" CppVersion=\"20\" Compiler=\"g++\">\n"
+            "    <Configuration Name=\"Debug\"><Flags><Item>O0</Item></Flags><Defines><Item>DEBUG</Item></Defines></Configuration>\n"
+            "    <Configuration Name=\"Release\"><Flags><Item>O2</Item></Flags></Configuration>\n"
+            "    <IncludeDirs><Item>inc</Item></IncludeDirs><SourceDirs><Item>src</Item></SourceDirs>\n"
+            "  </Project>\n"
+            "  <Project Name=\"App\" Kind=\"ConsoleApp\" Language=\"C++\" Compiler=\"g++\">\n"
+            "    <Configuration Name=\"Debug\"></Configuration><References><Item>Lib</Item></References>\n"
+            "  </Project>\n"
+            "</Workspace>\n";
+        {
+            Workspace wks = {};
+            CHECK(LoadWorkspace(&wks, lpXml)); // Parsed, and the snapshot written
+        }
+
+        const std::string snapshotFilepath = std::string{ "ws.xml" } + WorkspaceSnapshot::Extension;
+        const std::string snapshot = ReadFile(snapshotFilepath);
+        CHECK(!snapshot.empty());
+
+        WorkspaceSnapshot::XmlStamp stamp = {};
+        CHECK(WorkspaceSnapshot::GetXmlStamp("ws.xml", &stamp));
+        {
+            Workspace wks = {};
+            CHECK(WorkspaceSnapshot::Load(&wks, "ws.xml", &stamp));
+            CHECK(wks.Projects.size() == 2ull && wks.Projects[1].Name == "App" && wks.Projects[1].References == (List<std::string_view>{ "Lib" }));
+            CHECK(wks.Projects.size() == 2ull && wks.Projects[0].Wks == &wks && wks.Projects[0].Configurations.size() == 2ull);
+            CHECK(wks.Pools.size() == 1ull && wks.Pools[0].Name == "link");
+        }
+
+        // Cut short anywhere, it fails to load (and leaves the workspace empty)
+        for (size_t kSize = 0; kSize < snapshot.size(); kSize++)
+        {
+            WriteFile(snapshotFilepath, std::string_view{ snapshot }.substr(0, kSize));
+            Workspace wks = {};
+            const bool bLoaded = WorkspaceSnapshot::Load(&wks, "ws.xml", &stamp);
+            CHECK(!bLoaded);
+            CHECK(wks.Projects.empty() && wks.Pools.empty());
+            if (bLoaded)
+            {
+                break;
+            }
+        }
+
+        // Damaged anywhere, it loads or fails, but never reads outside the file
+        uint64_t kRandom = 1;
+        const auto Next = [&kRandom](uint64_t Bound) -> uint64_t
+        {
+            kRandom = kRandom * 6364136223846793005ull + 1442695040888963407ull;
+            return (kRandom >> 33) % Bound;
+        };
+        for (uint32_t kRun = 0; kRun < 2000; kRun++)
+        {
+            std::string damaged = snapshot;
+            for (uint64_t kBytes = 1 + Next(4); kBytes > 0; kBytes--)
+            {
+                const size_t kOffset = (size_t)Next(damaged.size());
+                damaged[kOffset] = Next(4) ? (char)Next(256) : (char)0xff;
+            }
+            WriteFile(snapshotFilepath, damaged);
+
+            WorkspaceSnapshot::XmlStamp damagedStamp = stamp;
+            Workspace wks = {};
+            if (!WorkspaceSnapshot::Load(&wks, "ws.xml", &damagedStamp))
+            {
+                CHECK(wks.Projects.empty() && wks.Pools.empty());
+            }
+        }
+
+        // Of another XML
+        WriteFile(snapshotFilepath, snapshot);
+        WriteFile("ws.xml", std::string{ lpXml } + " ");
+        CHECK(WorkspaceSnapshot::GetXmlStamp("ws.xml", &stamp));
+        Workspace wks = {};
+        CHECK(!WorkspaceSnapshot::Load(&wks, "ws.xml", &stamp));
+    }
+
+    // Equal strings of a loaded workspace share their data, from the XML as from the snapshot
+    void TestWorkspaceInterning() noexcept
+    {
+        using namespace Cbuild;
+
+        const char* lpXml =
+            "<Workspace Name=\"Tests\">\n"
+            "  <Project Name=\"Lib\" Kind=\"StaticLibrary\" Language=\"C\" Compiler=\"gcc\">\n"
+            "    <Configuration Name=\"Debug\"><Defines><Item>SHARED</Item></Defines></Configuration>\n"
+            "  </Project>\n"
+            "  <Project Name=\"App\" Kind=\"ConsoleApp\" Language=\"C\" Compiler=\"gcc\">\n"
+            "    <Configuration Name=\"Debug\"><Defines><Item>SHARED</Item></Defines></Configuration>\n"
+            "    <References><Item>Lib</Item></References>\n"
+            "  </Project>\n"
+            "</Workspace>\n";
+        for (const char* lpFrom : { "xml", "snapshot" })
+        {
+            Workspace wks = {};
+            CHECK(LoadWorkspace(&wks, lpXml));
+            CHECK(std::filesystem::exists(std::string{ "ws.xml" } + WorkspaceSnapshot::Extension));
+            if (wks.Projects.size() != 2ull)
+            {
+                printf("FAIL: unit_tests: %s: loaded from the %s, %zu projects\n", g_Test, lpFrom, wks.Projects.size());
+                g_Failures++;
+                continue;
+            }
+
+            const Project& lib = wks.Projects[0];
+            const Project& app = wks.Projects[1];
+            CHECK(app.References.size() == 1ull && Utils::InternedEqual{}(app.References[0], lib.Name));
+            CHECK(Utils::InternedEqual{}(app.Compiler, lib.Compiler) && Utils::InternedEqual{}(app.Language, lib.Language));
+            CHECK(!Utils::InternedEqual{}(app.Name, lib.Name));
+
+            const auto itLib = lib.Configurations.find("Debug");
+            const auto itApp = app.Configurations.find("Debug");
+            CHECK(itLib != lib.Configurations.end() && itApp != app.Configurations.end());
+            if (itLib != lib.Configurations.end() && itApp != app.Configurations.end())
+            {
+                CHECK(Utils::InternedEqual{}(itLib->first, itApp->first) && Utils::InternedEqual{}(itLib->first, itApp->second.Name));
+                CHECK(itLib->second.Defines.size() == 1ull && itApp->second.Defines.size() == 1ull
+                    && Utils::InternedEqual{}(itLib->second.Defines[0], itApp->second.Defines[0]));
+            }
+
+            std::unordered_map<std::string_view, int, Utils::InternedHash, Utils::InternedEqual> byName = {};
+            byName[lib.Name] = 1;
+            CHECK(byName.contains(app.References[0]));
+        }
+    }
+
+    void TestReadDepfile() noexcept
+    {
+        using namespace Cbuild;
+
+        WriteFile("a.d", "obj/a.o: src/a.c inc/x.h \\\n  inc/with\\ space.h inc/hash\\#.h \\\r\n  ./inc/../inc/dollar$$.h\ninc/x.h:\n\ninc/later.h:\n");
+        const List<std::string> headers = Exec::ReadDepfile("a.d", "./src/a.c");
+        CHECK(headers == (List<std::string>{
+            Utils::MakeNormalFilepath("inc/x.h"),
+            Utils::MakeNormalFilepath("inc/with space.h"),
+            Utils::MakeNormalFilepath("inc/hash#.h"),
+            Utils::MakeNormalFilepath("inc/dollar$.h"),
+        }));
+
+        // Without a trailing newline, and with a drive letter like path that is not the target
+        WriteFile("b.d", "b.o: C:/src/b.c C:/inc/b.h");
+        CHECK(Exec::ReadDepfile("b.d", "C:/src/b.c") == (List<std::string>{ Utils::MakeNormalFilepath("C:/inc/b.h") }));
+
+        CHECK(Exec::ReadDepfile("missing.d", "a.c").empty());
+    }
+
+    void TestIncludeScanner() noexcept
+    {
+        using namespace Cbuild;
+
+        // Every header exists, what is not an include must still not be found
+        for (const char* lpHeader : { "src/in_line_comment.h", "src/in_block_comment.h", "src/in_string.h", "src/in_raw_string.h",
+            "src/in_char.h", "src/not_at_line_start.h", "inc/unused.h" })
+        {
+            WriteFile(lpHeader, "");
+        }
+        WriteFile("src/local.h", "#include \"nested.h\"\n");
+        WriteFile("src/nested.h", "#pragma once\n");
+        WriteFile("inc/angled.h", "  #  include_next <deep/deeper.h>\n");
+        WriteFile("inc/deep/deeper.h", "");
+        WriteFile("src/a.c",
+            "#include \"local.h\"\n"
+            "\t# include <angled.h> // trailing comment\n"
+            "// #include \"in_line_comment.h\"\n"
+            "/* #include \"in_block_comment.h\"\n"
+            "#include \"in_block_comment.h\" */\n"
+            "const char* s = \"#include \\\"in_string.h\\\"\";\n"
+            "const char* r = R\"x(\n#include \"in_raw_string.h\"\n)x\";\n"
+            "const char c = '\"'; int n = 1'000; /* \" */\n"
+            "int x; #include \"not_at_line_start.h\"\n"
+            "#include HEADER_MACRO\n"
+            "#include \"not_found.h\"\n");
+
+        Command cmd = { .Name = "cc", .Kind = CommandKind::Compile, .Input = "src/a.c", .Output = "a.o" };
+        cmd.Args = { "-c", "-Iinc" };
+
+        const List<std::string> expected =
+        {
+            Utils::MakeNormalFilepath("inc/angled.h"),
+            Utils::MakeNormalFilepath("inc/deep/deeper.h"),
+            Utils::MakeNormalFilepath("src/local.h"),
+            Utils::MakeNormalFilepath("src/nested.h"),
+        };
+        const auto ToSorted = [](const List<std::string_view>& Headers) -> List<std::string>
+        {
+            List<std::string> headers{ Headers.begin(), Headers.end() };
+            std::sort(headers.begin(), headers.end());
+            return headers;
+        };
+
+        Exec::BuildDatabase db = {};
+        {
+            Exec::IncludeScanner scanner{ db };
+            CHECK(ToSorted(scanner.Scan(cmd)) == expected);
+            CHECK(scanner.GetReadCount() == 5ull);
+            scanner.Store(db);
+        }
+
+        // Kept scans of unchanged files are not read again
+        Exec::IncludeScanner scanner{ db };
+        CHECK(ToSorted(scanner.Scan(cmd)) == expected);
+        CHECK(scanner.GetReadCount() == 0ull);
+    }
+
+    void TestTargetSelection() noexcept
+    {
+        using namespace Cbuild;
+        using Scope = TargetSelection::Scope;
+
+        WriteFile("src/core/core.c", "");
+        WriteFile("src/app/main.c", "");
+        WriteFile("src/tool/tool.c", "");
+        Workspace wks = {};
+        CHECK(LoadWorkspace(&wks,
+            "<Workspace Name=\"Tests\">\n"
+            "  <OutputDir>bin</OutputDir><IntermediateDir>bin-int</IntermediateDir>\n"
+            "  <Project Name=\"Core\" Kind=\"StaticLibrary\" Language=\"C\" Compiler=\"gcc\">\n"
+            "    <Configuration Name=\"Debug\"></Configuration><SourceDirs><Item>src/core</Item></SourceDirs>\n"
+            "  </Project>\n"
+            "  <Project Name=\"App\" Kind=\"ConsoleApp\" Language=\"C\" Compiler=\"gcc\">\n"
+            "    <Configuration Name=\"Debug\"></Configuration><SourceDirs><Item>src/app</Item></SourceDirs>\n"
+            "    <References><Item>Core</Item></References>\n"
+            "  </Project>\n"
+            "  <Project Name=\"Tool\" Kind=\"ConsoleApp\" Language=\"C\" Compiler=\"gcc\">\n"
+            "    <Configuration Name=\"Debug\"></Configuration><SourceDirs><Item>src/tool</Item></SourceDirs>\n"
+            "  </Project>\n"
+            "</Workspace>\n"));
+        CHECK(wks.Projects.size() == 3ull);
+        if (wks.Projects.size() != 3ull)
+        {
+            return;
+        }
+
+        TargetSelection everything = {};
+        CHECK(everything.Select(wks, "Debug", {}));
+        CHECK(everything.Projects == (List<Scope>{ Scope::Whole, Scope::Whole, Scope::Whole }));
+
+        // A project, and what it references
+        TargetSelection app = {};
+        CHECK(app.Select(wks, "Debug", { "App" }));
+        CHECK(app.Projects == (List<Scope>{ Scope::Whole, Scope::Whole, Scope::None }));
+
+        // Its output
+        TargetSelection output = {};
+        CHECK(output.Select(wks, "Debug", { "./bin/Debug/Tool.exe" }));
+        CHECK(output.Projects == (List<Scope>{ Scope::None, Scope::None, Scope::Whole }));
+
+        // A source, and the object of another one
+        TargetSelection files = {};
+        CHECK(files.Select(wks, "Debug", { "src/tool/tool.c", "bin-int/Debug/core.o" }));
+        CHECK(files.Projects == (List<Scope>{ Scope::Files, Scope::None, Scope::Files }));
+        CHECK(files.Files.size() == 2ull && files.Files.contains(Utils::MakeNormalFilepath("src/tool/tool.c"))
+            && files.Files.contains(Utils::MakeNormalFilepath("bin-int/Debug/core.o")));
+
+        // A whole project wins over its files
+        TargetSelection both = {};
+        CHECK(both.Select(wks, "Debug", { "src/core/core.c", "App" }));
+        CHECK(both.Projects[0] == Scope::Whole);
+
+        // Neither a project nor one of their files
+        TargetSelection unknown = {};
+        CHECK(!unknown.Select(wks, "Debug", { "Nope" }));
+        TargetSelection unknownObject = {};
+        CHECK(!unknownObject.Select(wks, "Debug", { "bin-int/Debug/missing.o" }));
+    }
+
+    // A job run by `RunShellJobs`: it logs `+<Name>` to `log` when it starts, and `-<Name>` when it ends
+    struct ShellJob
+    {
+        std::string Name = {};
+        List<uint32_t> Dependencies = {}; // Jobs it waits for
+        uint32_t RecordedMs = 0; // How long a previous build took (0 = never built)
+        uint64_t RecordedRssKb = 0; // And its peak memory
+        int32_t Pool = -1;
+        const char* Sleep = "0"; // Seconds
+    };
+
+    // Runs the jobs through the executor, as a build runs its graph
+    int32_t RunShellJobs(const List<ShellJob>& Jobs, const List<uint32_t>& PoolDepths, const Cbuild::ExecutionOptions& Options) noexcept
+    {
+        using namespace Cbuild;
+
+        List<Command> cmds = {};
+        cmds.reserve(Jobs.size()); // The graph points into it
+        Exec::BuildDatabase db = {};
+        Exec::JobGraph graph = {};
+        for (const uint32_t kDepth : PoolDepths)
+        {
+            graph.AddPool(kDepth);
+        }
+        for (const ShellJob& job : Jobs)
+        {
+            Command& cmd = cmds.emplace_back(Command{ .Name = "sh", .Kind = CommandKind::Custom, .Output = job.Name + ".out" });
+            cmd.Args = { "-c", std::format("echo +{} >> log; sleep {}; echo -{} >> log; : > {}.out", job.Name, job.Sleep, job.Name, job.Name) };
+            if (job.RecordedMs || job.RecordedRssKb)
+            {
+                Exec::NodeRecord& record = db.Touch(cmd.Output);
+                record.DurationMs = job.RecordedMs;
+                record.PeakRssKb = job.RecordedRssKb;
+            }
+            graph.Add(&cmd, job.Pool);
+        }
+        for (uint32_t kIndex = 0; kIndex < Jobs.size(); kIndex++)
+        {
+            for (const uint32_t kDependency : Jobs[kIndex].Dependencies)
+            {
+                graph.AddEdge(kDependency, kIndex);
+            }
+        }
+        graph.Finalize();
+        graph.Estimate(db);
+        graph.Sort();
+        graph.MarkDirty(db);
+        graph.ComputeCriticalPaths();
+
+        // Not a child of make, nor a parent of what the next run starts
+        const char* lpMakeflags = getenv("MAKEFLAGS");
+        const std::string makeflags = lpMakeflags ? lpMakeflags : "";
+        unsetenv("MAKEFLAGS");
+        const int32_t result = Exec::Executor{ graph, db, Options }.Run();
+        if (lpMakeflags)
+        {
+            setenv("MAKEFLAGS", makeflags.c_str(), 1);
+        }
+        else
+        {
+            unsetenv("MAKEFLAGS");
+        }
+        return result;
+    }
+
+    // The jobs in the order they started
+    List<std::string> GetStartOrder() noexcept
+    {
+        List<std::string> order = {};
+        std::istringstream iss{ ReadFile("log") };
+        for (std::string line = {}; std::getline(iss, line);)
+        {
+            if (line.starts_with("+"))
+            {
+                order.push_back(line.substr(1ull));
+            }
+        }
+        return order;
+    }
+
+    // How many of the named jobs (all if none are) ran at once, at most
+    uint32_t GetMaxRunning(const List<std::string>& Names = {}) noexcept
+    {
+        uint32_t kRunning = 0, kMaxRunning = 0;
+        std::istringstream iss{ ReadFile("log") };
+        for (std::string line = {}; std::getline(iss, line);)
+        {
+            if (!Names.empty() && std::find(Names.begin(), Names.end(), line.substr(1ull)) == Names.end())
+            {
+                continue;
+            }
+            kRunning = line.starts_with("+") ? kRunning + 1 : kRunning - 1;
+            kMaxRunning = std::max(kMaxRunning, kRunning);
+        }
+        return kMaxRunning;
+    }
+
+    // Makes the jobs dirty again, with an empty log
+    void CleanShellJobs(const List<ShellJob>& Jobs) noexcept
+    {
+        for (const ShellJob& job : Jobs)
+        {
+            std::filesystem::remove(job.Name + ".out");
+        }
+        WriteFile("log", "");
+    }
+
+    void TestCriticalPathOrder() noexcept
+    {
+        Cbuild::ExecutionOptions options = {};
+        options.Jobs = 1;
+
+        // One at a time, the longest remaining path to the final job first, whatever the order they were added in.
+        // `head` is quick, but everything after it takes longest.
+        const List<ShellJob> jobs =
+        {
+            { .Name = "short1", .RecordedMs = 10 },
+            { .Name = "short2", .RecordedMs = 10 },
+            { .Name = "long", .RecordedMs = 2000 },
+            { .Name = "head", .RecordedMs = 10 },
+            { .Name = "tail", .Dependencies = { 3 }, .RecordedMs = 5000 },
+            { .Name = "final", .Dependencies = { 0, 1, 2, 4 }, .RecordedMs = 100 },
+        };
+        CHECK(RunShellJobs(jobs, {}, options) == 0);
+        CHECK(GetStartOrder() == (List<std::string>{ "head", "tail", "long", "short1", "short2", "final" }));
+
+        // Without records every job is guessed alike: the longest chain still goes first, then the order they were added in
+        CleanShellJobs(jobs);
+        List<ShellJob> unrecorded = jobs;
+        for (ShellJob& job : unrecorded)
+        {
+            job.RecordedMs = 0;
+        }
+        CHECK(RunShellJobs(unrecorded, {}, options) == 0);
+        CHECK(GetStartOrder() == (List<std::string>{ "head", "short1", "short2", "long", "tail", "final" }));
+    }
+
+    void TestMemoryAdmission() noexcept
+    {
+        Cbuild::ExecutionOptions options = {};
+        options.Jobs = 4;
+
+        const List<ShellJob> jobs =
+        {
+            { .Name = "a", .RecordedRssKb = 60ull * 1024ull, .Sleep = "0.5" },
+            { .Name = "b", .RecordedRssKb = 60ull * 1024ull, .Sleep = "0.5" },
+            { .Name = "c", .RecordedRssKb = 60ull * 1024ull, .Sleep = "0.5" },
+            { .Name = "d", .RecordedRssKb = 60ull * 1024ull, .Sleep = "0.5" },
+        };
+
+        // Only as many jobs start as their recorded peaks fit in the budget
+        options.MemoryBudgetKb = 100ull * 1024ull;
+        CHECK(RunShellJobs(jobs, {}, options) == 0);
+        CHECK(GetMaxRunning() == 1);
+
+        CleanShellJobs(jobs);
+        options.MemoryBudgetKb = 130ull * 1024ull;
+        CHECK(RunShellJobs(jobs, {}, options) == 0);
+        CHECK(GetMaxRunning() == 2);
+
+        // A job bigger than the whole budget still runs, on its own
+        CleanShellJobs(jobs);
+        options.MemoryBudgetKb = 50ull * 1024ull;
+        CHECK(RunShellJobs(jobs, {}, options) == 0);
+        CHECK(GetMaxRunning() == 1);
+        CHECK(GetStartOrder().size() == 4ull);
+    }
+
+
+    void TestPools() noexcept
+    {
+        Cbuild::ExecutionOptions options = {};
+        options.Jobs = 4;
+
+        // Four jobs in a pool, and two outside of it that run alongside
+        List<ShellJob> jobs =
+        {
+            { .Name = "p1", .Pool = 0, .Sleep = "0.3" },
+            { .Name = "p2", .Pool = 0, .Sleep = "0.3" },
+            { .Name = "p3", .Pool = 0, .Sleep = "0.3" },
+            { .Name = "p4", .Pool = 0, .Sleep = "0.3" },
+            { .Name = "free1", .Sleep = "0.5" },
+            { .Name = "free2", .Sleep = "0.5" },
+        };
+        const List<std::string> pool = { "p1", "p2", "p3", "p4" };
+
+        CHECK(RunShellJobs(jobs, { 1 }, options) == 0);
+        CHECK(GetMaxRunning(pool) == 1);
+        CHECK(GetMaxRunning() == 3);
+
+        CleanShellJobs(jobs);
+        CHECK(RunShellJobs(jobs, { 2 }, options) == 0);
+        CHECK(GetMaxRunning(pool) == 2);
+        CHECK(GetStartOrder().size() == 6ull);
+    }
+
+}
+
+int main()
+{
+    namespace stdfs = std::filesystem;
+
+    // As cbuild's own main does, the pool's threads expect it
+    const sigset_t signals = Cbuild::Platform::GetInterruptSignals();
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    const std::pair<const char*, void (*)()> tests[] =
+    {
+        { "BuildDatabaseRoundTrip", TestBuildDatabaseRoundTrip },
+        { "BuildDatabaseJournal", TestBuildDatabaseJournal },
+        { "WorkspaceSnapshot", TestWorkspaceSnapshot },
+        { "WorkspaceInterning", TestWorkspaceInterning },
+        { "ReadDepfile", TestReadDepfile },
+        { "IncludeScanner", TestIncludeScanner },
+        { "TargetSelection", TestTargetSelection },
+        { "CriticalPathOrder", TestCriticalPathOrder },
+        { "MemoryAdmission", TestMemoryAdmission },
+        { "Pools", TestPools },
+    };
+
+    std::error_code ec = {};
+    const stdfs::path cwd = stdfs::current_path();
+    for (const auto& [lpName, Test] : tests)
+    {
+        char lpDir[] = "/tmp/cbuild_unit_XXXXXX";
+        if (!mkdtemp(lpDir))
+        {
+            printf("FAIL: unit_tests: could not create a directory for %s\n", lpName);
+            return 1;
+        }
+        stdfs::current_path(lpDir);
+
+        g_Test = lpName;
+        const uint32_t kFailures = g_Failures;
+        Test();
+        if (g_Failures == kFailures)
+        {
+            printf("ok: unit_tests: %s\n", lpName);
+        }
+
+        stdfs::current_path(cwd);
+        stdfs::remove_all(lpDir, ec);
+    }
+    return g_Failures ? 1 : 0;
+}